@@ -0,0 +1,164 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+/****************************************************************************************************/
+/*							Banded connectivity on the ring											*/
+/****************************************************************************************************/
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "Network_Image.h"
+
+/* NOTE On the ring a presynaptic neuron i targets the postsynaptic neurons (i + d) % N_post with
+ * small offsets d. If the presynaptic population is not larger than the postsynaptic one, every
+ * synapse is therefore given by the postsynaptic neuron j and the offset d, and the projection is
+ * a band of 2w+1 diagonals around the ring. Diagonal k holds the number of synapses from neuron
+ * i = (j + k - w) mod N_post onto every neuron j, which is zero where i >= N_pre.
+ *
+ * The input is then a dense product over the diagonals. Each diagonal is an unit stride loop over
+ * the neurons of a block, that reads a window of the presynaptic variables, which is extended by w
+ * on both sides to resolve the wraparound once per block. The inputs are added diagonal by
+ * diagonal rather than in the order of the CSR rows, so they differ in the last bits.
+ */
+class Band_Matrix {
+public:
+    Band_Matrix() = default;
+
+    /* Whether a projection can be represented as a band. The number of synapses between two neurons
+     * is stored in a byte, which is plenty for the ring
+     */
+    static bool applicable(const Network_Image& image, int proj) {
+        return image.numCells(image.pre(proj)) <= image.numCells(image.post(proj))
+               && image.maxMultiplicity(proj) <= 255;
+    }
+
+    /* Half width of the band of the rows [first, last) of a projection */
+    static int bandWidth(const Network_Image& image, int proj, int first, int last) {
+        const int numPost = image.numCells(image.post(proj));
+        int width = 0;
+        for (int j=first; j < last; ++j) {
+            for (int i : image.inputs(proj, j)) {
+                width = std::max(width, std::abs(offset(i, j, numPost)));
+            }
+        }
+        return width;
+    }
+
+    /* Band of the rows [first, last) of a projection, which are owned by this rank */
+    Band_Matrix(const Network_Image& image, int proj, int first, int last)
+    : numPost (image.numCells(image.post(proj))),
+      numPre  (image.numCells(image.pre (proj))),
+      rowBegin(first),
+      numRows (last - first),
+      width   (bandWidth(image, proj, first, last)) {
+        weights.assign((uint64_t)(2*width + 1)*numRows, 0);
+        for (int j=first; j < last; ++j) {
+            for (int i : image.inputs(proj, j)) {
+                weights[(uint64_t)(offset(i, j, numPost) + width)*numRows + j - rowBegin]++;
+            }
+        }
+    }
+
+    int			halfWidth	(void) const {return width;}
+    uint64_t	bytes		(void) const {return weights.size()*sizeof(uint8_t);}
+
+    /* Add the input of the postsynaptic neurons [first, last) to in[0, last-first) for up to two
+     * synaptic variables. The window buffers are provided by the calling thread
+     */
+    void accumulate(int first, int last, const double* s_A, const double* s_B,
+                    double* in_A, double* in_B, std::vector<double>& window) const {
+        const int length = last - first + 2*width;
+        window.resize(2*length);
+        double* win_A = window.data();
+        double* win_B = win_A + length;
+        in_B = s_B ? in_B : in_A;
+        fillWindow(first, length, s_A, win_A);
+        if (s_B) {
+            fillWindow(first, length, s_B, win_B);
+        }
+
+        /* The neurons are processed in tiles, so that their inputs stay in the L1 cache while the
+         * diagonals are streamed
+         */
+        for (int tile=0; tile < last - first; tile += Tile) {
+            const int n = std::min(last - first - tile, (int)Tile);
+            double* A = in_A + tile;
+            double* B = in_B + tile;
+            for (int k=0; k < 2*width + 1; ++k) {
+                const uint8_t* w = weights.data() + (uint64_t)k*numRows + first - rowBegin + tile;
+                const double* a = win_A + k + tile;
+                if (s_B) {
+                    const double* b = win_B + k + tile;
+                    #pragma omp simd
+                    for (int j=0; j < n; ++j) {
+                        A[j] += w[j]*a[j];
+                        B[j] += w[j]*b[j];
+                    }
+                } else {
+                    #pragma omp simd
+                    for (int j=0; j < n; ++j) {
+                        A[j] += w[j]*a[j];
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    static const int Tile = 512;
+
+    /* Offset d of a synapse from i onto j, wrapped into (-N_post/2, N_post/2] */
+    static int offset(int i, int j, int numPost) {
+        int d = (j - i) % numPost;
+        if (d > numPost/2) {
+            d -= numPost;
+        } else if (d <= -numPost/2) {
+            d += numPost;
+        }
+        return -d;
+    }
+
+    /* Presynaptic variables of the ring positions first-w ... first+length-w-1 */
+    void fillWindow(int first, int length, const double* s, double* window) const {
+        int i = ((first - width) % numPost + numPost) % numPost;
+        for (int x=0; x < length; ++x) {
+            window[x] = i < numPre ? s[i] : 0.0;
+            if (++i == numPost) {
+                i = 0;
+            }
+        }
+    }
+
+    int					numPost	 = 0;
+    int					numPre	 = 0;
+    int					rowBegin = 0;	/* First owned postsynaptic neuron	*/
+    int					numRows	 = 0;	/* Number of owned rows				*/
+    int					width	 = 0;
+    std::vector<uint8_t>	weights;	/* Number of synapses per diagonal and neuron	*/
+};
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
@@ -25,11 +25,13 @@
 /****************************************************************************************************/
 #include <iostream>
 #include <chrono>
+#include <string>
 #include <vector>
 
 #include "Data_Storage.h"
 #include "Initialize_Neurons.h"
 #include "Iterate_ODE.h"
+#include "Live_Monitor.h"
 
 /****************************************************************************************************/
 /*										Fixed simulation settings									*/
@@ -43,6 +45,24 @@ extern const std::vector<int> NumCells = {128,				/* Number of pyramidal cells
                                          128,				/* Number of thalamocortical cells		*/
                                          32};				/* Number of reticular cells			*/
 extern const int N_Cores= 7;								/* Number of CPU cores					*/
+extern const unsigned Seed = 1;								/* Seed of the network generation		*/
+extern const std::string NetworkCache = ".";				/* Directory of cached network images	*/
+extern const bool ProceduralConnectivity = false;			/* Regenerate synapses on the fly		*/
+extern const networkLayout Layout = RING;					/* Spatial arrangement of the neurons	*/
+extern const threadPinning Pinning = PIN_NONE;				/* Binding of the threads to cores		*/
+extern const neuronOrdering Ordering = ORDER_GENERATED;		/* Numbering of the neurons				*/
+extern const gatherEngine Engine = GATHER_AUTO;			/* Summation of the synaptic input		*/
+extern const propagationMode Propagation = PROPAGATE_PULL;	/* Pull or push the synaptic input		*/
+extern const double DeltaTolerance = 1E-6;					/* Smallest pushed synaptic change		*/
+extern const int ResyncInterval = 100;						/* Steps between full input summations	*/
+extern const std::vector<driveSettings> Drive(4, {DRIVE_NONE, 0.0, 0.0, 0.0, 0.0, 5.0});	/* External drive	*/
+extern const std::vector<double> VoltageNoise = {0.0, 0.0, 0.0, 0.0};	/* Voltage noise in mV/sqrt(ms)		*/
+extern const std::string StimulusFile = "";				/* Stimulus currents, empty for none	*/
+extern const int Trials = 1;								/* Number of trials of the ensemble		*/
+extern const double WarmupTime = 0.0;						/* Discarded transient in ms, 0 for none	*/
+extern const std::string MonitorName = "";				/* Shared memory of the monitor, or none	*/
+extern const int MonitorInterval = 50;						/* Steps between two monitor samples	*/
+extern const int N_Ranks = 1;								/* Number of processes (shared memory)	*/
 /****************************************************************************************************/
 /*										 		end			 										*/
 /****************************************************************************************************/
@@ -52,8 +72,8 @@ extern const int N_Cores= 7;								/* Number of CPU cores					*/
 /*										Main simulation routine										*/
 /****************************************************************************************************/
 int main(void) {
-    /* Seed the random number generator */
-    srand(time(NULL));
+    /* Split the network across the ranks. They are forked, so this precedes any parallel region */
+    Domain domain(N_Ranks);
 
     /* Initialize the populations */
     /* Take the time of the simulation */
@@ -64,19 +84,51 @@ int main(void) {
     std::vector<Inhibitory_Neuron> IN;
     std::vector<Thalamocortical_Neuron> TC;
     std::vector<Reticular_Neuron> RE;
-    setupNetwork(PY, IN, TC, RE);
+    Synaptic_Input synapses(domain);
+    setupNetwork(PY, IN, TC, RE, synapses);
+
+    /* Publish the progress for viewers, every rank under its own name */
+    Live_Monitor monitor;
+    if (!MonitorName.empty()) {
+        monitor.open(domain.rank() ? MonitorName + "." + std::to_string(domain.rank()) : MonitorName, MonitorInterval);
+    }
 
     /* Simulation */
     start = std::chrono::high_resolution_clock::now();
     for (int t = 0; t < T*res; ++t) {
-        Iterate_ODE(PY, IN, TC, RE);
+        Iterate_ODE(PY, IN, TC, RE, synapses, &monitor);
+        monitor.update(PY, IN, TC, RE);
     }
     end = std::chrono::high_resolution_clock::now();
+    monitor.close();
 
     /* Time consumed by the simulation */
-    double dif = 1E-3*std::chrono::duration_cast<std::chrono::milliseconds>( end - start ).count();
-    std::cout << "simulation done!\n";
-    std::cout << "took " << dif 	<< " seconds" << "\n";
+    double dif = std::chrono::duration<double>(end - start).count();
+#ifdef PROFILE_TRACE
+    profiler().writeTrace(std::string(PROFILE_TRACE) + "." + std::to_string(domain.rank()), domain.rank());
+#endif
+    if (domain.rank() == 0) {
+        std::cout << "simulation done!\n";
+        std::cout << "took " << dif 	<< " seconds" << "\n";
+    }
+
+    /* The ranks report the memory of their part of the network in turn */
+    for (int r = 0; r < domain.size(); ++r) {
+        if (r == domain.rank()) {
+            reportMemory(std::cout, PY, IN, TC, RE, synapses);
+            std::cout.flush();
+        }
+        domain.barrier();
+    }
+    if (domain.rank() != 0) {
+        return 0;
+    }
+#ifdef PROFILE_PHASES
+    profiler().report(std::cout);
+#endif
+#ifdef PROFILE_COUNTERS
+    profiler().reportCounters(std::cout, {(int)PY.size(), (int)IN.size(), (int)TC.size(), (int)RE.size()});
+#endif
     std::cout << "end\n";
 }
 /****************************************************************************************************/
@@ -0,0 +1,353 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+/****************************************************************************************************/
+/*		Shared library with a C interface															*/
+/*																									*/
+/*		Compile as the main file, e.g.																*/
+/*		g++ -std=c++11 -O2 -fopenmp -fPIC -shared Bazhenov_lib.cpp *_Neuron.cpp -o libbazhenov.so	*/
+/*																									*/
+/*		The interface is declared in Bazhenov_lib.h.												*/
+/****************************************************************************************************/
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "Bazhenov_lib.h"
+#include "Data_Storage.h"
+#include "Initialize_Neurons.h"
+#include "Iterate_ODE.h"
+
+/****************************************************************************************************/
+/*										Fixed simulation settings									*/
+/****************************************************************************************************/
+extern const int T		= 1;								/* Simulation length in s				*/
+extern const int res 	= 5E4;								/* Number of iteration steps per s		*/
+extern const double dt 	= 1E3/res;							/* Duration of a timestep in ms			*/
+extern const std::vector<int> NumCells = {128,				/* Number of pyramidal cells			*/
+                                         32,				/* Number of inhibitory cells			*/
+                                         128,				/* Number of thalamocortical cells		*/
+                                         32};				/* Number of reticular cells			*/
+extern const int N_Cores= 7;								/* Number of CPU cores					*/
+extern const unsigned Seed = 1;								/* Seed of the network generation		*/
+extern const std::string NetworkCache = ".";				/* Directory of cached network images	*/
+extern const bool ProceduralConnectivity = false;			/* Regenerate synapses on the fly		*/
+extern const networkLayout Layout = RING;					/* Spatial arrangement of the neurons	*/
+extern const threadPinning Pinning = PIN_NONE;				/* Binding of the threads to cores		*/
+extern const neuronOrdering Ordering = ORDER_GENERATED;		/* Numbering of the neurons				*/
+extern const gatherEngine Engine = GATHER_AUTO;			/* Summation of the synaptic input		*/
+extern const propagationMode Propagation = PROPAGATE_PULL;	/* Pull or push the synaptic input		*/
+extern const double DeltaTolerance = 1E-6;					/* Smallest pushed synaptic change		*/
+extern const int ResyncInterval = 100;						/* Steps between full input summations	*/
+extern const std::vector<driveSettings> Drive(4, {DRIVE_NONE, 0.0, 0.0, 0.0, 0.0, 5.0});	/* External drive	*/
+extern const std::vector<double> VoltageNoise = {0.0, 0.0, 0.0, 0.0};	/* Voltage noise in mV/sqrt(ms)		*/
+extern const std::string StimulusFile = "";				/* Stimulus currents, empty for none	*/
+extern const int Trials = 1;								/* Number of trials of the ensemble		*/
+extern const double WarmupTime = 0.0;						/* Discarded transient in ms, 0 for none	*/
+extern const int N_Ranks = 1;								/* Number of processes (shared memory)	*/
+/****************************************************************************************************/
+/*										 		end			 										*/
+/****************************************************************************************************/
+
+
+/****************************************************************************************************/
+/*										Simulation handle											*/
+/****************************************************************************************************/
+struct bz_simulation {
+    explicit bz_simulation(unsigned seed) : settings(fixedSettings()) {
+        settings.seed = seed;
+        setupNetwork(PY, IN, TC, RE, synapses, settings);
+    }
+
+    void reset(void) {
+        const Network_Image& image = synapses.network();
+        PY = initializeNeurons<Pyramidal_Neuron>(image, PYRAMIDAL, 0, image.numCells(PYRAMIDAL), Trials);
+        IN = initializeNeurons<Inhibitory_Neuron>(image, INHIBITORY, 0, image.numCells(INHIBITORY), Trials);
+        TC = initializeNeurons<Thalamocortical_Neuron>(image, THALAMOCORTICAL, 0, image.numCells(THALAMOCORTICAL), Trials);
+        RE = initializeNeurons<Reticular_Neuron>(image, RETICULAR, 0, image.numCells(RETICULAR), Trials);
+        synapses.restart();
+        synapses.setChannels(settings.parameters);
+        synapses.setDrive(settings.drive);
+        synapses.setNoise(settings.noise);
+        Warm_Start::equilibrate(PY, IN, TC, RE, synapses, settings.drive, settings.noise);
+        synapses.setStimulus(settings.stimulus);
+        steps		= 0;
+        recorded	= 0;
+    }
+
+    void record(int recordInterval, int capacity) {
+        if (recordInterval < 0 || capacity < 0) {
+            throw std::runtime_error("The interval and capacity of the recording must not be negative!");
+        }
+        interval = recordInterval;
+        rows	 = capacity;
+        traces[BZ_TRACE_V_PY ].assign((size_t)rows*PY.size()*Lanes, 0.0);
+        traces[BZ_TRACE_V_IN ].assign((size_t)rows*IN.size()*Lanes, 0.0);
+        traces[BZ_TRACE_CA_PY].assign((size_t)rows*PY.size()*Lanes, 0.0);
+        recorded = 0;
+    }
+
+    void advance(int numSteps) {
+        std::vector<double*> pData = {traces[0].data(), traces[1].data(), traces[2].data()};
+        for (int t=0; t < numSteps; ++t) {
+            Iterate_ODE(PY, IN, TC, RE, synapses);
+            ++steps;
+            if (interval > 0 && rows > 0 && steps % interval == 0) {
+                get_data(recorded++ % rows, PY, IN, TC, RE, pData);
+            }
+        }
+    }
+
+    /* View of a state variable of the neurons. Every neuron is a record, so the stride is its size.
+     * With several lanes the second dimension are the lanes of a neuron
+     */
+    template<class NEURON>
+    static void state(std::vector<NEURON>& neurons, std::array<lane, 5> NEURON::*variable,
+                      bz_buffer* view) {
+        view->data		 = neurons.empty() ? nullptr : (neurons.data()->*variable)[0].v;
+        view->format	 = 'd';
+        view->itemsize	 = sizeof(double);
+        view->ndim		 = Lanes > 1 ? 2 : 1;
+        view->shape[0]	 = neurons.size();
+        view->shape[1]	 = Lanes > 1 ? Lanes : 0;
+        view->strides[0] = sizeof(NEURON);
+        view->strides[1] = Lanes > 1 ? sizeof(double) : 0;
+    }
+
+    void state(int population, const std::string& name, bz_buffer* view) {
+        if (population == BZ_PYRAMIDAL) {
+            if		(name == "V" || name == "Vs")	state(PY, &Pyramidal_Neuron::Vs,	 view);
+            else if (name == "Vd")					state(PY, &Pyramidal_Neuron::Vd,	 view);
+            else if (name == "Ca")					state(PY, &Pyramidal_Neuron::Ca,	 view);
+            else if (name == "Na")					state(PY, &Pyramidal_Neuron::Na,	 view);
+            else if (name == "s_AMPA")				state(PY, &Pyramidal_Neuron::s_AMPA, view);
+            else if (name == "s_NMDA")				state(PY, &Pyramidal_Neuron::s_NMDA, view);
+            else throw std::runtime_error("Unknown variable " + name + " of the pyramidal cells!");
+        } else if (population == BZ_INHIBITORY) {
+            if		(name == "V")					state(IN, &Inhibitory_Neuron::V,	  view);
+            else if (name == "s_GABA")				state(IN, &Inhibitory_Neuron::s_GABA, view);
+            else throw std::runtime_error("Unknown variable " + name + " of the inhibitory cells!");
+        } else if (population == BZ_THALAMOCORTICAL) {
+            if		(name == "V")					state(TC, &Thalamocortical_Neuron::V,		view);
+            else if (name == "Ca")					state(TC, &Thalamocortical_Neuron::Ca,		view);
+            else if (name == "s_AMPA")				state(TC, &Thalamocortical_Neuron::s_AMPA,	view);
+            else if (name == "s_NMDA")				state(TC, &Thalamocortical_Neuron::s_NMDA,	view);
+            else throw std::runtime_error("Unknown variable " + name + " of the thalamocortical cells!");
+        } else if (population == BZ_RETICULAR) {
+            if		(name == "V")					state(RE, &Reticular_Neuron::V,		 view);
+            else if (name == "s_GABA")				state(RE, &Reticular_Neuron::s_GABA, view);
+            else throw std::runtime_error("Unknown variable " + name + " of the reticular cells!");
+        } else {
+            throw std::runtime_error("Unknown population!");
+        }
+    }
+
+    /* View of the ring of recorded rows */
+    void trace(int index, bz_buffer* view) {
+        if (index < BZ_TRACE_V_PY || index > BZ_TRACE_CA_PY) {
+            throw std::runtime_error("Unknown trace!");
+        }
+        const int64_t columns = (index == BZ_TRACE_V_IN ? IN.size() : PY.size())*Lanes;
+        view->data		 = traces[index].data();
+        view->format	 = 'd';
+        view->itemsize	 = sizeof(double);
+        view->ndim		 = 2;
+        view->shape[0]	 = rows;
+        view->shape[1]	 = columns;
+        view->strides[0] = columns*sizeof(double);
+        view->strides[1] = sizeof(double);
+    }
+
+    void identities(int population, bz_buffer* view) {
+        const Network_Image& image = synapses.network();
+        if (population < 0 || population >= image.numPopulations()) {
+            throw std::runtime_error("Unknown population!");
+        }
+        view->data		 = const_cast<int32_t*>(image.identities(population));
+        view->format	 = 'i';
+        view->itemsize	 = sizeof(int32_t);
+        view->ndim		 = 1;
+        view->shape[0]	 = image.numCells(population);
+        view->shape[1]	 = 0;
+        view->strides[0] = sizeof(int32_t);
+        view->strides[1] = 0;
+    }
+
+    /* Network and state of the neurons */
+    std::vector<Pyramidal_Neuron>		PY;
+    std::vector<Inhibitory_Neuron>		IN;
+    std::vector<Thalamocortical_Neuron>	TC;
+    std::vector<Reticular_Neuron>		RE;
+    Synaptic_Input						synapses;
+    runSettings							settings;
+
+    /* Time steps since the last reset and the recorded traces */
+    int64_t				steps	 = 0;
+    int64_t				recorded = 0;
+    int					interval = 0;
+    int					rows	 = 0;
+    std::vector<double>	traces[3];
+};
+/****************************************************************************************************/
+/*										 		end			 										*/
+/****************************************************************************************************/
+
+
+/****************************************************************************************************/
+/*										C interface													*/
+/****************************************************************************************************/
+static thread_local std::string lastError;
+
+/* Run a function of the interface and turn exceptions into an error code */
+template<typename FUNCTION>
+static int guarded(bz_simulation* sim, FUNCTION&& function) {
+    if (!sim) {
+        lastError = "No simulation!";
+        return -1;
+    }
+    try {
+        function(*sim);
+        return 0;
+    } catch (const std::exception& error) {
+        lastError = error.what();
+        return -1;
+    }
+}
+
+static void checkPopulation(int population) {
+    if (population < BZ_PYRAMIDAL || population > BZ_RETICULAR) {
+        throw std::runtime_error("Unknown population!");
+    }
+}
+
+extern "C" {
+
+const char* bz_error(void) {
+    return lastError.c_str();
+}
+
+bz_simulation* bz_create(unsigned seed) {
+    try {
+        return new bz_simulation(seed);
+    } catch (const std::exception& error) {
+        lastError = error.what();
+        return nullptr;
+    }
+}
+
+void bz_destroy(bz_simulation* sim) {
+    delete sim;
+}
+
+int bz_set_drive(bz_simulation* sim, int population, int mode, double rate, double weight,
+                 double mean, double sigma, double tau) {
+    return guarded(sim, [&](bz_simulation& s) {
+        checkPopulation(population);
+        if (mode < BZ_DRIVE_NONE || mode > BZ_DRIVE_OU) {
+            throw std::runtime_error("Unknown drive!");
+        }
+        s.settings.drive[population] = {(driveMode)mode, rate, weight, mean, sigma, tau};
+    });
+}
+
+int bz_set_noise(bz_simulation* sim, int population, double amplitude) {
+    return guarded(sim, [&](bz_simulation& s) {
+        checkPopulation(population);
+        s.settings.noise[population] = amplitude;
+    });
+}
+
+int bz_set_stimulus(bz_simulation* sim, const char* file) {
+    return guarded(sim, [&](bz_simulation& s) {s.settings.stimulus = file ? file : "";});
+}
+
+int bz_set_parameter(bz_simulation* sim, const char* name, double value) {
+    return guarded(sim, [&](bz_simulation& s) {
+        double* parameter = findParameter(s.settings.parameters, name ? name : "");
+        if (!parameter) {
+            throw std::runtime_error("Unknown parameter!");
+        }
+        *parameter = value;
+    });
+}
+
+int bz_set_defaults(bz_simulation* sim) {
+    return guarded(sim, [](bz_simulation& s) {
+        const unsigned seed = s.settings.seed;
+        s.settings		= fixedSettings();
+        s.settings.seed	= seed;
+    });
+}
+
+int bz_reset(bz_simulation* sim) {
+    return guarded(sim, [](bz_simulation& s) {s.reset();});
+}
+
+int bz_record(bz_simulation* sim, int interval, int capacity) {
+    return guarded(sim, [&](bz_simulation& s) {s.record(interval, capacity);});
+}
+
+int bz_advance(bz_simulation* sim, int steps) {
+    return guarded(sim, [&](bz_simulation& s) {s.advance(steps);});
+}
+
+int64_t bz_steps(const bz_simulation* sim) {
+    return sim ? sim->steps : 0;
+}
+
+int64_t bz_recorded(const bz_simulation* sim) {
+    return sim ? sim->recorded : 0;
+}
+
+int bz_state(bz_simulation* sim, int population, const char* variable, bz_buffer* view) {
+    return guarded(sim, [&](bz_simulation& s) {
+        if (!variable || !view) {
+            throw std::runtime_error("No variable or view!");
+        }
+        s.state(population, variable, view);
+    });
+}
+
+int bz_trace(bz_simulation* sim, int trace, bz_buffer* view) {
+    return guarded(sim, [&](bz_simulation& s) {
+        if (!view) {
+            throw std::runtime_error("No view!");
+        }
+        s.trace(trace, view);
+    });
+}
+
+int bz_identities(bz_simulation* sim, int population, bz_buffer* view) {
+    return guarded(sim, [&](bz_simulation& s) {
+        if (!view) {
+            throw std::runtime_error("No view!");
+        }
+        s.identities(population, view);
+    });
+}
+
+}
+/****************************************************************************************************/
+/*										 		end			 										*/
+/****************************************************************************************************/
@@ -0,0 +1,119 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+
+/****************************************************************************************************/
+/*									C interface of the simulation									*/
+/****************************************************************************************************/
+#ifndef BAZHENOV_LIB_H
+#define BAZHENOV_LIB_H
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* NOTE A simulation is an opaque handle, that keeps the network between runs. The settings that may
+ * change between runs take effect on the next reset, so a handle is created and configured once
+ * and then advanced and reset as often as needed.
+ *
+ * The state of the neurons and the recorded traces are exposed as views of the memory of the
+ * simulation, described by a pointer, shape and strides in bytes as in numpy. The neurons are
+ * stored as records, so a state variable is a strided view. State views are valid until the next
+ * reset, trace views until the recording is changed. All functions that return int return 0 on
+ * success and -1 on failure, with the reason given by bz_error.
+ */
+typedef struct bz_simulation bz_simulation;
+
+enum {
+    BZ_PYRAMIDAL		= 0,
+    BZ_INHIBITORY		= 1,
+    BZ_THALAMOCORTICAL	= 2,
+    BZ_RETICULAR		= 3
+};
+
+enum {
+    BZ_DRIVE_NONE		= 0,
+    BZ_DRIVE_POISSON	= 1,
+    BZ_DRIVE_OU			= 2
+};
+
+/* Recorded traces, see get_data */
+enum {
+    BZ_TRACE_V_PY		= 0,	/* Somatic voltage of the pyramidal cells		*/
+    BZ_TRACE_V_IN		= 1,	/* Voltage of the inhibitory cells				*/
+    BZ_TRACE_CA_PY		= 2		/* Dendritic calcium of the pyramidal cells		*/
+};
+
+typedef struct {
+    void*		data;
+    char		format;			/* 'd' for double, 'i' for int32				*/
+    int			itemsize;
+    int			ndim;
+    int64_t		shape[2];
+    int64_t		strides[2];		/* In bytes										*/
+} bz_buffer;
+
+/* Message of the last failure of the calling thread */
+const char*		bz_error		(void);
+
+/* Create the network of the given seed with the settings of the library, or NULL on failure */
+bz_simulation*	bz_create		(unsigned seed);
+void			bz_destroy		(bz_simulation* sim);
+
+/* Settings of the next reset, bz_set_defaults returns to the settings of the library */
+int				bz_set_drive	(bz_simulation* sim, int population, int mode, double rate,
+                                 double weight, double mean, double sigma, double tau);
+int				bz_set_noise	(bz_simulation* sim, int population, double amplitude);
+int				bz_set_stimulus	(bz_simulation* sim, const char* file);
+int				bz_set_defaults	(bz_simulation* sim);
+
+/* Channel conductivity of a population, named like "PY.g_KNa" or "TC.g_Ca" */
+int				bz_set_parameter(bz_simulation* sim, const char* name, double value);
+
+/* Return to the initial state of the neurons and apply the settings */
+int				bz_reset		(bz_simulation* sim);
+
+/* Record the traces every interval time steps into a ring of capacity rows */
+int				bz_record		(bz_simulation* sim, int interval, int capacity);
+
+/* Advance the simulation by a number of time steps */
+int				bz_advance		(bz_simulation* sim, int steps);
+
+/* Time steps since the last reset and rows recorded since then */
+int64_t			bz_steps		(const bz_simulation* sim);
+int64_t			bz_recorded		(const bz_simulation* sim);
+
+/* Views of a state variable, e.g. "V", of a recorded trace and of the generated ids of a population */
+int				bz_state		(bz_simulation* sim, int population, const char* variable, bz_buffer* view);
+int				bz_trace		(bz_simulation* sim, int trace, bz_buffer* view);
+int				bz_identities	(bz_simulation* sim, int population, bz_buffer* view);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BAZHENOV_LIB_H
+/****************************************************************************************************/
+/*										 		end			 										*/
+/****************************************************************************************************/
@@ -30,11 +30,13 @@
 #include "mex.h"
 #include "matrix.h"
 
+#include <string>
 #include <vector>
 
 #include "Data_Storage.h"
 #include "Initialize_Neurons.h"
 #include "Iterate_ODE.h"
+#include "Live_Monitor.h"
 
 /****************************************************************************************************/
 /*										Fixed simulation settings									*/
@@ -48,6 +50,23 @@ extern const std::vector<int> NumCells = {128,  /* Number of pyramidal cells		*/
                                           128,	/* Number of thalamocortical cells	*/
                                           32};	/* Number of reticular cells		*/
 extern const int N_Cores= 7;					/* Number of CPU cores				*/
+extern const unsigned Seed = 1;					/* Seed of the network generation	*/
+extern const std::string NetworkCache = ".";	/* Directory of cached networks		*/
+extern const bool ProceduralConnectivity = false;	/* Regenerate synapses on the fly	*/
+extern const networkLayout Layout = RING;			/* Spatial arrangement of neurons	*/
+extern const threadPinning Pinning = PIN_NONE;		/* Binding of the threads to cores	*/
+extern const neuronOrdering Ordering = ORDER_GENERATED;	/* Numbering of the neurons			*/
+extern const gatherEngine Engine = GATHER_AUTO;	/* Summation of the synaptic input	*/
+extern const propagationMode Propagation = PROPAGATE_PULL;	/* Pull or push the input	*/
+extern const double DeltaTolerance = 1E-6;			/* Smallest pushed synaptic change	*/
+extern const int ResyncInterval = 100;				/* Steps between full summations	*/
+extern const std::vector<driveSettings> Drive(4, {DRIVE_NONE, 0.0, 0.0, 0.0, 0.0, 5.0});	/* External drive */
+extern const std::vector<double> VoltageNoise = {0.0, 0.0, 0.0, 0.0};	/* Voltage noise [mV/sqrt(ms)] */
+extern const std::string StimulusFile = "";		/* Stimulus currents, empty for none	*/
+extern const int Trials = 1;					/* Number of trials of the ensemble	*/
+extern const double WarmupTime = 0.0;				/* Discarded transient in ms		*/
+extern const std::string MonitorName = "";		/* Shared memory of the monitor		*/
+extern const int MonitorInterval = 50;				/* Steps between monitor samples	*/
 /****************************************************************************************************/
 /*										 		end			 										*/
 /****************************************************************************************************/
@@ -59,21 +78,19 @@ mxArray* SetMexArray(int N, int M);
 /*										rhs defines inputs											*/
 /****************************************************************************************************/
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
-    /* Seed the random number generator */
-    srand(time(NULL));
-
     /* Initialize the populations */
     std::vector<Pyramidal_Neuron> PY;
     std::vector<Inhibitory_Neuron> IN;
     std::vector<Thalamocortical_Neuron> TC;
     std::vector<Reticular_Neuron> RE;
-    setupNetwork(PY, IN, TC, RE);
+    Synaptic_Input synapses;
+    setupNetwork(PY, IN, TC, RE, synapses);
 
     /* Data container in MATLAB format */
     std::vector<mxArray*> Data;
-    Data.push_back(SetMexArray(NumCells[PYRAMIDAL],  T*res/red));	// Ve
-    Data.push_back(SetMexArray(NumCells[INHIBITORY], T*res/red));	// Vi
-    Data.push_back(SetMexArray(NumCells[PYRAMIDAL],  T*res/red));	// Ca
+    Data.push_back(SetMexArray(NumCells[PYRAMIDAL] *Trials, T*res/red));	// Ve
+    Data.push_back(SetMexArray(NumCells[INHIBITORY]*Trials, T*res/red));	// Vi
+    Data.push_back(SetMexArray(NumCells[PYRAMIDAL] *Trials, T*res/red));	// Ca
 
     /* Pointer to the data blocks */
     std::vector<double*> pData;
@@ -82,16 +99,26 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
         pData.push_back(mxGetPr(arrayptr));
     }
 
+    /* Publish the progress for viewers */
+    Live_Monitor monitor;
+    if (!MonitorName.empty()) {
+        monitor.open(MonitorName, MonitorInterval);
+    }
+
     /* Simulation */
     int count = 0;
     for (int t = 0; t < T*res; ++t) {
-        Iterate_ODE(PY, IN, TC, RE);
+        Iterate_ODE(PY, IN, TC, RE, synapses, &monitor);
+        monitor.update(PY, IN, TC, RE);
         if(t%red==0){
             get_data(count++, PY, IN, TC, RE, pData);
         }
 
     }
 
+    /* Return the data in the order in which the neurons were generated */
+    restoreNeuronOrder(synapses.network(), pData, count, Trials);
+
     /* Return the data containers */
     nlhs = Data.size();
     for(const auto& arrayptr : Data) {
@@ -0,0 +1,401 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+/****************************************************************************************************/
+/*		Simulation server that keeps the networks warm												*/
+/*																									*/
+/*		Compile as the main file together with the library, e.g.									*/
+/*		g++ -std=c++11 -O2 -fopenmp Bazhenov_server.cpp Bazhenov_lib.cpp *_Neuron.cpp -o Server		*/
+/*																									*/
+/*		Server [--socket bazhenov.sock]																*/
+/*																									*/
+/*		Every line sent to the Unix socket is a request of key=value pairs, answered by a line		*/
+/*		"ok ..." or "error <message>". A run request, e.g.											*/
+/*																									*/
+/*		run seed=1 steps=5000 interval=10 probes=V_PY,V_IN noise.PY=0.1 output=shm:/trace			*/
+/*																									*/
+/*		simulates the network of the seed from its initial state and writes the probes, each a		*/
+/*		row-major matrix of doubles with a row per recorded step, one after the other to a file		*/
+/*		("file:<path>") or a shared memory object ("shm:<name>"), which the client unlinks.			*/
+/*		drive[.POP]=mode[,rate,weight,mean,sigma,tau], noise[.POP]=amplitude, stimulus=<file> and	*/
+/*		param.POP.g_X=conductance, e.g. param.PY.g_KNa=1.33, override the settings of the library	*/
+/*		for the run, drive and noise for all or a single population.								*/
+/*		"status" lists the warm networks and "shutdown" stops the server.							*/
+/****************************************************************************************************/
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Bazhenov_lib.h"
+
+/****************************************************************************************************/
+/*										Warm networks												*/
+/****************************************************************************************************/
+/* Simulations of the recently used seeds. The least recently used one is destroyed once more
+ * than MaxNetworks are resident
+ */
+class Network_Pool {
+public:
+    static const unsigned MaxNetworks = 8;
+
+    bz_simulation* get(unsigned seed) {
+        auto found = networks.find(seed);
+        if (found != networks.end()) {
+            order.remove(seed);
+            order.push_front(seed);
+            return found->second.get();
+        }
+        bz_simulation* sim = bz_create(seed);
+        if (!sim) {
+            throw std::runtime_error(bz_error());
+        }
+        networks.emplace(seed, handle(sim, bz_destroy));
+        order.push_front(seed);
+        if (order.size() > MaxNetworks) {
+            networks.erase(order.back());
+            order.pop_back();
+        }
+        return sim;
+    }
+
+    std::string status(void) const {
+        std::string seeds;
+        for (unsigned seed : order) {
+            seeds += (seeds.empty() ? "" : ",") + std::to_string(seed);
+        }
+        return "networks=" + std::to_string(order.size()) + " seeds=" + seeds;
+    }
+
+private:
+    typedef std::unique_ptr<bz_simulation, void(*)(bz_simulation*)> handle;
+    std::map<unsigned, handle>	networks;
+    std::list<unsigned>			order;		/* Most recently used first		*/
+};
+/****************************************************************************************************/
+/*										 		end			 										*/
+/****************************************************************************************************/
+
+
+/****************************************************************************************************/
+/*										Requests													*/
+/****************************************************************************************************/
+static const char* Populations[4]	= {"PY", "IN", "TC", "RE"};
+static const char* Probes[3]		= {"V_PY", "V_IN", "CA_PY"};
+static const char* Modes[3]			= {"none", "poisson", "ou"};
+
+/* Index of a name in a list of names */
+static int lookup(const std::string& name, const char* const* names, int count, const char* what) {
+    for (int i=0; i < count; ++i) {
+        if (name == names[i]) {
+            return i;
+        }
+    }
+    throw std::runtime_error("Unknown " + std::string(what) + " " + name + "!");
+}
+
+static std::vector<std::string> split(const std::string& list, char separator) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, separator)) {
+        items.push_back(item);
+    }
+    return items;
+}
+
+static void check(int status) {
+    if (status != 0) {
+        throw std::runtime_error(bz_error());
+    }
+}
+
+/* Populations addressed by a key, e.g. "noise" for all or "noise.PY" for one */
+static std::vector<int> populations(const std::string& key) {
+    const size_t dot = key.find('.');
+    if (dot == std::string::npos) {
+        return {0, 1, 2, 3};
+    }
+    return {lookup(key.substr(dot + 1), Populations, 4, "population")};
+}
+
+/* Write the recorded probes one after the other to a file or shared memory object */
+static void writeOutput(bz_simulation* sim, const std::string& output, const std::vector<int>& probes,
+                        int64_t rows, std::string& shapes) {
+    std::vector<bz_buffer> views(probes.size());
+    size_t bytes = 0;
+    for (unsigned p=0; p < probes.size(); ++p) {
+        check(bz_trace(sim, probes[p], &views[p]));
+        bytes += rows*views[p].shape[1]*sizeof(double);
+        shapes += std::string(" ") + Probes[probes[p]] + "=" + std::to_string(rows) + "x"
+                + std::to_string(views[p].shape[1]);
+    }
+
+    const int fd = output.compare(0, 5, "file:") == 0
+                 ? open(output.c_str() + 5, O_CREAT | O_TRUNC | O_RDWR, 0644)
+                 : shm_open(output.c_str() + 4, O_CREAT | O_TRUNC | O_RDWR, 0600);
+    if (fd < 0 || ftruncate(fd, std::max<size_t>(bytes, 1)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        throw std::runtime_error("Could not create the output " + output + "!");
+    }
+    void* region = mmap(nullptr, std::max<size_t>(bytes, 1), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) {
+        throw std::runtime_error("Could not map the output " + output + "!");
+    }
+    char* data = static_cast<char*>(region);
+    for (const bz_buffer& view : views) {
+        const size_t size = rows*view.shape[1]*sizeof(double);
+        std::memcpy(data, view.data, size);
+        data += size;
+    }
+    munmap(region, std::max<size_t>(bytes, 1));
+}
+
+/* Simulate a run request and return the description of its output */
+static std::string run(Network_Pool& pool, const std::vector<std::string>& arguments) {
+    unsigned seed = 1;
+    int64_t steps = 0;
+    int interval = 1;
+    std::vector<int> probes = {0, 1, 2};
+    std::string output;
+    std::vector<std::pair<std::string, std::string>> overrides;
+    for (unsigned a=1; a < arguments.size(); ++a) {
+        const size_t equal = arguments[a].find('=');
+        if (equal == std::string::npos) {
+            throw std::runtime_error("Expected key=value instead of " + arguments[a] + "!");
+        }
+        const std::string key	= arguments[a].substr(0, equal);
+        const std::string value	= arguments[a].substr(equal + 1);
+        if (key == "seed") {
+            seed = std::stoul(value);
+        } else if (key == "steps") {
+            steps = std::stoll(value);
+        } else if (key == "interval") {
+            interval = std::stoi(value);
+        } else if (key == "probes") {
+            probes.clear();
+            for (const std::string& probe : split(value, ',')) {
+                probes.push_back(lookup(probe, Probes, 3, "probe"));
+            }
+        } else if (key == "output") {
+            output = value;
+        } else {
+            overrides.push_back({key, value});
+        }
+    }
+    if (steps <= 0 || interval <= 0 || output.empty()) {
+        throw std::runtime_error("A run needs steps, a positive interval and an output!");
+    }
+    if (steps > INT_MAX) {
+        throw std::runtime_error("A run advances and records at most INT_MAX steps!");
+    }
+    if (output.compare(0, 5, "file:") != 0 && output.compare(0, 4, "shm:") != 0) {
+        throw std::runtime_error("Unknown output " + output + "!");
+    }
+
+    bz_simulation* sim = pool.get(seed);
+    check(bz_set_defaults(sim));
+    for (const auto &entry : overrides) {
+        const std::string& key = entry.first;
+        const std::string name = key.substr(0, key.find('.'));
+        if (name == "drive") {
+            const std::vector<std::string> values = split(entry.second, ',');
+            std::vector<double> numbers = {0.0, 0.0, 0.0, 0.0, 5.0};
+            for (unsigned v=1; v < values.size() && v <= numbers.size(); ++v) {
+                numbers[v-1] = std::stod(values[v]);
+            }
+            const int mode = lookup(values.empty() ? "" : values[0], Modes, 3, "drive");
+            for (int type : populations(key)) {
+                check(bz_set_drive(sim, type, mode, numbers[0], numbers[1], numbers[2], numbers[3], numbers[4]));
+            }
+        } else if (name == "noise") {
+            for (int type : populations(key)) {
+                check(bz_set_noise(sim, type, std::stod(entry.second)));
+            }
+        } else if (key == "stimulus") {
+            check(bz_set_stimulus(sim, entry.second.c_str()));
+        } else if (name == "param" && key.size() > name.size() + 1) {
+            check(bz_set_parameter(sim, key.c_str() + name.size() + 1, std::stod(entry.second)));
+        } else {
+            throw std::runtime_error("Unknown setting " + key + "!");
+        }
+    }
+
+    const int rows = steps/interval;
+    check(bz_record(sim, interval, rows));
+    check(bz_reset(sim));
+    const auto start = std::chrono::steady_clock::now();
+    check(bz_advance(sim, steps));
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::string shapes;
+    writeOutput(sim, output, probes, rows, shapes);
+    return "steps=" + std::to_string(steps) + " seconds=" + std::to_string(seconds)
+         + " output=" + output + shapes;
+}
+
+/* Answer a request line. Returns false on shutdown */
+static bool answer(Network_Pool& pool, const std::string& line, std::string& reply) {
+    const std::vector<std::string> arguments = split(line, ' ');
+    try {
+        if (arguments.empty() || arguments[0].empty()) {
+            throw std::runtime_error("Empty request!");
+        } else if (arguments[0] == "run") {
+            reply = "ok " + run(pool, arguments);
+        } else if (arguments[0] == "status") {
+            reply = "ok " + pool.status();
+        } else if (arguments[0] == "shutdown") {
+            reply = "ok";
+            return false;
+        } else {
+            throw std::runtime_error("Unknown request " + arguments[0] + "!");
+        }
+    } catch (const std::exception& error) {
+        reply = std::string("error ") + error.what();
+    }
+    return true;
+}
+/****************************************************************************************************/
+/*										 		end			 										*/
+/****************************************************************************************************/
+
+
+/****************************************************************************************************/
+/*										Main server routine											*/
+/****************************************************************************************************/
+int main(int argc, char** argv) {
+    std::string path = "bazhenov.sock";
+    for (int i=1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) {
+            path = argv[++i];
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--socket bazhenov.sock]\n";
+            return 1;
+        }
+    }
+
+    /* A client that hangs up must not stop the server */
+    std::signal(SIGPIPE, SIG_IGN);
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "The socket path " << path << " is too long!\n";
+        return 1;
+    }
+    std::strcpy(address.sun_path, path.c_str());
+    unlink(path.c_str());
+    const int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0 || bind(server, (sockaddr*)&address, sizeof(address)) != 0 || listen(server, 16) != 0) {
+        std::cerr << "Could not listen on " << path << ": " << std::strerror(errno) << "\n";
+        return 1;
+    }
+    std::cout << "listening on " << path << "\n";
+
+    /* The listening socket and all clients are polled, so a client that keeps its connection open
+     * does not lock out the others. The requests are still served one after the other, as every
+     * run uses all cores
+     */
+    Network_Pool pool;
+    std::vector<pollfd> fds = {{server, POLLIN, 0}};
+    std::vector<std::string> buffers(1);	/* Incomplete request line of every client	*/
+    bool running = true;
+    while (running) {
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Could not poll the clients: " << std::strerror(errno) << "\n";
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            const int client = accept(server, nullptr, nullptr);
+            if (client >= 0) {
+                fds.push_back({client, POLLIN, 0});
+                buffers.emplace_back();
+            }
+        }
+        for (unsigned c=1; running && c < fds.size(); ++c) {
+            if (!(fds[c].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            char chunk[4096];
+            const ssize_t count = read(fds[c].fd, chunk, sizeof(chunk));
+            bool connected = count > 0;
+            if (connected) {
+                buffers[c].append(chunk, count);
+            }
+            size_t end;
+            while (running && connected && (end = buffers[c].find('\n')) != std::string::npos) {
+                std::string reply;
+                running = answer(pool, buffers[c].substr(0, end), reply);
+                buffers[c].erase(0, end + 1);
+                reply += "\n";
+                connected = write(fds[c].fd, reply.data(), reply.size()) >= 0;
+            }
+            if (!connected) {
+                close(fds[c].fd);
+                fds[c].fd = -1;
+            }
+        }
+
+        /* Forget the clients that hung up */
+        for (unsigned c=fds.size() - 1; c > 0; --c) {
+            if (fds[c].fd < 0) {
+                fds.erase(fds.begin() + c);
+                buffers.erase(buffers.begin() + c);
+            }
+        }
+    }
+    for (unsigned c=1; c < fds.size(); ++c) {
+        close(fds[c].fd);
+    }
+    close(server);
+    unlink(path.c_str());
+    std::cout << "end\n";
+}
+/****************************************************************************************************/
+/*										 		end			 										*/
+/****************************************************************************************************/
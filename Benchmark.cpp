@@ -0,0 +1,445 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+/****************************************************************************************************/
+/*		Benchmark of the network																	*/
+/*																									*/
+/*		Compile as the main file, e.g.																*/
+/*		g++ -std=c++11 -O2 -fopenmp Benchmark.cpp *_Neuron.cpp -o Benchmark						*/
+/*																									*/
+/*		Benchmark [--sizes 1,2,4,8] [--threads 1,2,4,8] [--steps 1000] [--output file.json]			*/
+/*																									*/
+/*		Every configuration runs in a fresh process with the settings passed through the			*/
+/*		environment, so that the settings can stay constant as in the other main files.				*/
+/*		BENCHMARK_ENGINE=csr|banded|dense|auto selects the gather.									*/
+/*		BENCHMARK_PROPAGATION=pull|delta selects the propagation of the input.						*/
+/*		BENCHMARK_DRIVE=none|poisson|ou selects the external drive.									*/
+/*		BENCHMARK_NOISE=sigma sets the voltage noise.												*/
+/*		BENCHMARK_STIMULUS=file streams the stimulus currents from a file.							*/
+/*		BENCHMARK_TRIALS=K simulates K trials as an ensemble, a multiple of the lanes (-DLANES).	*/
+/****************************************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Data_Storage.h"
+#include "Initialize_Neurons.h"
+#include "Iterate_ODE.h"
+
+/****************************************************************************************************/
+/*										Configuration of a run										*/
+/****************************************************************************************************/
+/* Comma separated list of integers */
+static std::vector<int> parseList(const std::string& list) {
+    std::vector<int> values;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        values.push_back(std::stoi(item));
+    }
+    return values;
+}
+
+static std::string formatList(const std::vector<int>& values) {
+    std::string list;
+    for (unsigned i=0; i < values.size(); ++i) {
+        list += (i ? "," : "") + std::to_string(values[i]);
+    }
+    return list;
+}
+
+static std::vector<int> getCells(void) {
+    const char* cells = std::getenv("BENCHMARK_CELLS");
+    return cells ? parseList(cells) : std::vector<int>{128, 32, 128, 32};
+}
+
+static int getCores(void) {
+    const char* cores = std::getenv("BENCHMARK_CORES");
+    return cores ? std::stoi(cores) : 1;
+}
+
+/* Engine of the synaptic gather, "csr", "banded", "dense" or "auto" */
+static gatherEngine getEngine(void) {
+    const char* engine = std::getenv("BENCHMARK_ENGINE");
+    const std::string name = engine ? engine : "auto";
+    return name == "csr" ? GATHER_CSR : name == "banded" ? GATHER_BANDED
+         : name == "dense" ? GATHER_DENSE : GATHER_AUTO;
+}
+
+/* Propagation of the synaptic input, "pull" or "delta" */
+static propagationMode getPropagation(void) {
+    const char* propagation = std::getenv("BENCHMARK_PROPAGATION");
+    return propagation && std::string(propagation) == "delta" ? PROPAGATE_DELTA : PROPAGATE_PULL;
+}
+
+/* External drive of all populations, "none", "poisson" or "ou" */
+static std::vector<driveSettings> getDrive(void) {
+    const char* drive = std::getenv("BENCHMARK_DRIVE");
+    const std::string name = drive ? drive : "none";
+    const driveMode mode = name == "poisson" ? DRIVE_POISSON : name == "ou" ? DRIVE_OU : DRIVE_NONE;
+    return std::vector<driveSettings>(4, {mode, 2000.0, 0.5, 0.5, 1.0, 5.0});
+}
+
+/* Voltage noise of all populations in mV/sqrt(ms) */
+static std::vector<double> getNoise(void) {
+    const char* noise = std::getenv("BENCHMARK_NOISE");
+    return std::vector<double>(4, noise ? std::stod(noise) : 0.0);
+}
+
+/* Number of trials of the ensemble */
+static int getTrials(void) {
+    const char* trials = std::getenv("BENCHMARK_TRIALS");
+    return trials ? std::atoi(trials) : 1;
+}
+
+/* Stimulus file of the neurons, none by default */
+static std::string getStimulus(void) {
+    const char* file = std::getenv("BENCHMARK_STIMULUS");
+    return file ? file : "";
+}
+/****************************************************************************************************/
+/*										 		end			 										*/
+/****************************************************************************************************/
+
+
+/****************************************************************************************************/
+/*										Fixed simulation settings									*/
+/****************************************************************************************************/
+extern const int T		= 1;								/* Simulation length in s				*/
+extern const int res 	= 5E4;								/* Number of iteration steps per s		*/
+extern const double dt 	= 1E3/res;							/* Duration of a timestep in ms			*/
+extern const std::vector<int> NumCells = getCells();		/* Number of cells per population		*/
+extern const int N_Cores= getCores();						/* Number of CPU cores					*/
+extern const unsigned Seed = 1;								/* Seed of the network generation		*/
+extern const std::string NetworkCache = "";					/* Construction is part of the benchmark*/
+extern const bool ProceduralConnectivity = false;			/* Regenerate synapses on the fly		*/
+extern const networkLayout Layout = RING;					/* Spatial arrangement of the neurons	*/
+extern const threadPinning Pinning = PIN_NONE;				/* Binding of the threads to cores		*/
+extern const neuronOrdering Ordering = ORDER_GENERATED;		/* Numbering of the neurons				*/
+extern const gatherEngine Engine = getEngine();				/* Summation of the synaptic input		*/
+extern const propagationMode Propagation = getPropagation();	/* Pull or push the synaptic input		*/
+extern const double DeltaTolerance = 1E-6;					/* Smallest pushed synaptic change		*/
+extern const int ResyncInterval = 100;						/* Steps between full input summations	*/
+extern const std::vector<driveSettings> Drive = getDrive();	/* External drive of the populations	*/
+extern const std::vector<double> VoltageNoise = getNoise();	/* Voltage noise in mV/sqrt(ms)			*/
+extern const std::string StimulusFile = getStimulus();	/* Stimulus currents, empty for none	*/
+extern const int Trials = getTrials();						/* Number of trials of the ensemble		*/
+extern const double WarmupTime = 0.0;						/* Discarded transient in ms, 0 for none	*/
+/****************************************************************************************************/
+/*										 		end			 										*/
+/****************************************************************************************************/
+
+
+/****************************************************************************************************/
+/*										Measurement helpers											*/
+/****************************************************************************************************/
+typedef std::chrono::steady_clock::time_point timer;
+
+static timer now(void) {return std::chrono::steady_clock::now();}
+
+static double seconds(timer start, timer end) {
+    return std::chrono::duration<double>(end - start).count();
+}
+
+/* Simulated neurons, counting every trial of an ensemble */
+static long long totalCells(void) {
+    long long total = 0;
+    for (int cells : NumCells) {
+        total += cells;
+    }
+    return total*Trials;
+}
+/****************************************************************************************************/
+/*										 		end			 										*/
+/****************************************************************************************************/
+
+
+/****************************************************************************************************/
+/*										Microbenchmarks												*/
+/****************************************************************************************************/
+/* Time of the RK functions of a population in ns per neuron and call, single threaded. A neuron
+ * object advances all of its lanes, so the time is given per trial
+ */
+template<class NEURON, class PARAMETERS>
+static void benchmarkNeurons(std::vector<NEURON>& neurons, const PARAMETERS& channels,
+                             const char* name, int repetitions, std::ostream& out) {
+    double setRK = 0.0, addRK = 0.0;
+    for (int r=0; r < repetitions; ++r) {
+        timer start = now();
+        for (int N=0; N < 4; ++N) {
+            for (NEURON& neuron : neurons) {
+                neuron.set_RK(N, channels);
+            }
+        }
+        timer middle = now();
+        for (NEURON& neuron : neurons) {
+            neuron.add_RK();
+        }
+        setRK += seconds(start, middle);
+        addRK += seconds(middle, now());
+    }
+    out << "\"" << name << "\":{"
+        << "\"set_RK_ns\":" << 1E9*setRK/(4.0*repetitions*neurons.size()*Lanes) << ","
+        << "\"add_RK_ns\":" << 1E9*addRK/(1.0*repetitions*neurons.size()*Lanes) << "}";
+}
+
+static void runMicrobenchmarks(int repetitions) {
+    std::vector<Pyramidal_Neuron> PY;
+    std::vector<Inhibitory_Neuron> IN;
+    std::vector<Thalamocortical_Neuron> TC;
+    std::vector<Reticular_Neuron> RE;
+    Synaptic_Input synapses;
+
+    /* Network construction */
+    const int builds = 3;
+    uint64_t synapseCount = 0;
+    timer start = now();
+    for (int r=0; r < builds; ++r) {
+        Network_Image image = generateNetwork(Seed, defaultWidths());
+        synapseCount = 0;
+        for (int proj=0; proj < image.numProjections(); ++proj) {
+            synapseCount += image.numSynapses(proj);
+        }
+    }
+    const double construction = seconds(start, now())/builds;
+    setupNetwork(PY, IN, TC, RE, synapses);
+
+    std::ostream& out = std::cout;
+    out << "{\"cells\":[" << formatList(NumCells) << "],\"threads\":" << N_Cores << ",";
+    out << "\"construction\":{\"seconds\":" << construction
+        << ",\"synapses\":" << synapseCount
+        << ",\"synapses_per_second\":" << synapseCount/construction << "},";
+
+    benchmarkNeurons(PY, synapses.channels().PY, "pyramidal", repetitions, out);
+    out << ",";
+    benchmarkNeurons(IN, synapses.channels().IN, "inhibitory", repetitions, out);
+    out << ",";
+    benchmarkNeurons(TC, synapses.channels().TC, "thalamocortical", repetitions, out);
+    out << ",";
+    benchmarkNeurons(RE, synapses.channels().RE, "reticular", repetitions, out);
+    out << ",";
+
+    /* Synaptic gather of a single RK step */
+    start = now();
+    for (int r=0; r < repetitions; ++r) {
+        synapses.gather(r % 4, PY, IN, TC, RE);
+    }
+    const double gather = seconds(start, now())/repetitions;
+    out << "\"gather\":{\"ns_per_neuron\":" << 1E9*gather/totalCells()
+        << ",\"ns_per_synapse\":" << 1E9*gather/synapseCount << "},";
+
+    /* Recording of a time step */
+    std::vector<double> Data_PY(PY.size()*Lanes*repetitions), Data_IN(IN.size()*Lanes*repetitions),
+                        Data_Ca(PY.size()*Lanes*repetitions);
+    std::vector<double*> pData = {Data_PY.data(), Data_IN.data(), Data_Ca.data()};
+    start = now();
+    for (int r=0; r < repetitions; ++r) {
+        get_data(r, PY, IN, TC, RE, pData);
+    }
+    out << "\"get_data\":{\"ns_per_call\":" << 1E9*seconds(start, now())/repetitions << "},";
+
+    /* Memory footprint */
+    const uint64_t neuronBytes = PY.size()*sizeof(Pyramidal_Neuron) + IN.size()*sizeof(Inhibitory_Neuron)
+                               + TC.size()*sizeof(Thalamocortical_Neuron) + RE.size()*sizeof(Reticular_Neuron)
+                               + synapses.bufferBytes();
+    out << "\"memory\":{\"bytes_per_neuron\":" << (double)neuronBytes/totalCells()
+        << ",\"bytes_per_synapse\":" << (double)synapses.connectivityBytes()/std::max<uint64_t>(synapseCount, 1)
+        << "}}\n";
+}
+/****************************************************************************************************/
+/*										 		end			 										*/
+/****************************************************************************************************/
+
+
+/****************************************************************************************************/
+/*										End-to-end runs												*/
+/****************************************************************************************************/
+static void runSimulation(int steps) {
+    std::vector<Pyramidal_Neuron> PY;
+    std::vector<Inhibitory_Neuron> IN;
+    std::vector<Thalamocortical_Neuron> TC;
+    std::vector<Reticular_Neuron> RE;
+    Synaptic_Input synapses;
+    setupNetwork(PY, IN, TC, RE, synapses);
+
+    /* Warm up the caches and the thread pool */
+    for (int t=0; t < steps/10 + 1; ++t) {
+        Iterate_ODE(PY, IN, TC, RE, synapses);
+    }
+
+    timer start = now();
+    for (int t=0; t < steps; ++t) {
+        Iterate_ODE(PY, IN, TC, RE, synapses);
+    }
+    const double duration = seconds(start, now());
+    std::cout << "{\"cells\":[" << formatList(NumCells) << "],\"threads\":" << N_Cores
+              << ",\"steps\":" << steps << ",\"seconds\":" << duration
+              << ",\"neuron_steps_per_second\":" << totalCells()*steps/duration << "}\n";
+}
+
+/* Run a configuration in a fresh process and return its JSON result */
+static std::string runChild(const std::string& program, const std::string& mode,
+                            const std::vector<int>& cells, int cores, int steps) {
+    setenv("BENCHMARK_CELLS", formatList(cells).c_str(), 1);
+    setenv("BENCHMARK_CORES", std::to_string(cores).c_str(), 1);
+    const std::string command = "\"" + program + "\" " + mode + " --steps " + std::to_string(steps);
+    FILE* pipe = popen(command.c_str(), "r");
+    if (!pipe) {
+        throw std::runtime_error("Could not start the benchmark process!");
+    }
+    std::string result;
+    char buffer[4096];
+    while (fgets(buffer, sizeof(buffer), pipe)) {
+        result += buffer;
+    }
+    if (pclose(pipe) != 0 || result.empty()) {
+        throw std::runtime_error("Benchmark of " + formatList(cells) + " cells failed!");
+    }
+    while (!result.empty() && result.back() == '\n') {
+        result.pop_back();
+    }
+    return result;
+}
+
+/* Extract a number from a flat JSON result */
+static double getValue(const std::string& json, const std::string& key) {
+    const size_t pos = json.find("\"" + key + "\":");
+    if (pos == std::string::npos) {
+        throw std::runtime_error("Missing key " + key + "!");
+    }
+    return std::stod(json.substr(pos + key.size() + 3));
+}
+/****************************************************************************************************/
+/*										 		end			 										*/
+/****************************************************************************************************/
+
+
+/****************************************************************************************************/
+/*										Main benchmark routine										*/
+/****************************************************************************************************/
+int main(int argc, char** argv) {
+    std::vector<int> sizes = {1, 2, 4, 8};
+    std::vector<int> threads = {1, 2, 4, 8};
+    std::string mode, output;
+    int steps = 1000;
+    for (int i=1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--run" || arg == "--micro") {
+            mode = arg;
+        } else if (arg == "--sizes" && i + 1 < argc) {
+            sizes = parseList(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = parseList(argv[++i]);
+        } else if (arg == "--steps" && i + 1 < argc) {
+            steps = std::stoi(argv[++i]);
+        } else if (arg == "--output" && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--sizes 1,2,4,8] [--threads 1,2,4,8]"
+                      << " [--steps 1000] [--output file.json]\n";
+            return 1;
+        }
+    }
+
+    /* Child processes measure a single configuration */
+    if (mode == "--micro") {
+        runMicrobenchmarks(steps);
+        return 0;
+    }
+    if (mode == "--run") {
+        runSimulation(steps);
+        return 0;
+    }
+
+    /* The sizes are multiples of the default network */
+    const std::vector<int> base = getCells();
+    auto scaled = [&](int factor) {
+        std::vector<int> cells = base;
+        for (int& n : cells) {
+            n *= factor;
+        }
+        return cells;
+    };
+
+    const std::string micro = runChild(argv[0], "--micro", base, 1, steps);
+    std::vector<std::vector<std::string>> runs(sizes.size());
+    for (unsigned s=0; s < sizes.size(); ++s) {
+        for (int p : threads) {
+            runs[s].push_back(runChild(argv[0], "--run", scaled(sizes[s]), p, steps));
+            std::cerr << runs[s].back() << "\n";
+        }
+    }
+
+    /* Strong scaling keeps the size, weak scaling grows it with the number of threads */
+    std::ostringstream json;
+    json << "{\n\"micro\":" << micro << ",\n\"runs\":[";
+    for (unsigned s=0; s < sizes.size(); ++s) {
+        for (unsigned t=0; t < threads.size(); ++t) {
+            json << (s || t ? ",\n" : "\n") << runs[s][t];
+        }
+    }
+    json << "],\n\"strong_scaling\":[";
+    bool first = true;
+    for (unsigned s=0; s < sizes.size(); ++s) {
+        const double reference = getValue(runs[s][0], "neuron_steps_per_second")/threads[0];
+        for (unsigned t=0; t < threads.size(); ++t) {
+            const double rate = getValue(runs[s][t], "neuron_steps_per_second");
+            json << (first ? "\n" : ",\n") << "{\"size\":" << sizes[s] << ",\"threads\":" << threads[t]
+                 << ",\"efficiency\":" << rate/(reference*threads[t]) << "}";
+            first = false;
+        }
+    }
+    json << "],\n\"weak_scaling\":[";
+    first = true;
+    for (unsigned t=0; t < threads.size(); ++t) {
+        for (unsigned s=0; s < sizes.size(); ++s) {
+            if (sizes[s]*threads[0] != sizes[0]*threads[t]) {
+                continue;
+            }
+            /* The time per step stays constant for perfect weak scaling */
+            const double reference = totalCells()*sizes[0]/getValue(runs[0][0], "neuron_steps_per_second");
+            const double time = totalCells()*sizes[s]/getValue(runs[s][t], "neuron_steps_per_second");
+            json << (first ? "\n" : ",\n") << "{\"size\":" << sizes[s] << ",\"threads\":" << threads[t]
+                 << ",\"efficiency\":" << reference/time << "}";
+            first = false;
+        }
+    }
+    json << "]\n}\n";
+
+    if (output.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream file(output);
+        file << json.str();
+    }
+}
+/****************************************************************************************************/
+/*										 		end			 										*/
+/****************************************************************************************************/
@@ -0,0 +1,60 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+
+/****************************************************************************************************/
+/*								Channels of the neuron models										*/
+/****************************************************************************************************/
+#pragma once
+
+/* NOTE Channels are knocked out at compile time by passing their mask to the compiler, e.g.
+ * -DKNOCKOUT="CHANNEL_H|CHANNEL_T". The current of a knocked out channel is constant zero, which
+ * removes its evaluation from set_RK, and its gating variables are removed from the neurons
+ * together with their RK updates. An ablation therefore runs faster than the full model.
+ *
+ *	CHANNEL_KNA		sodium dependent potassium current of the pyramidal cells
+ *	CHANNEL_AR		inwardly rectifying potassium current of the pyramidal cells
+ *	CHANNEL_H		h current of the thalamocortical cells
+ *	CHANNEL_T		T-type calcium current of the thalamocortical and reticular cells
+ *
+ * The masks are macros, as the storage can only be removed by the preprocessor.
+ */
+#define CHANNEL_KNA	1
+#define CHANNEL_AR	2
+#define CHANNEL_H	4
+#define CHANNEL_T	8
+
+#ifndef KNOCKOUT
+#define KNOCKOUT	0
+#endif
+
+constexpr bool Has_I_KNa	= !((KNOCKOUT) & CHANNEL_KNA);
+constexpr bool Has_I_AR		= !((KNOCKOUT) & CHANNEL_AR);
+constexpr bool Has_I_h		= !((KNOCKOUT) & CHANNEL_H);
+constexpr bool Has_I_T		= !((KNOCKOUT) & CHANNEL_T);
+
+/* Mask of the knocked out channels, which is part of the configuration of a run */
+constexpr unsigned KnockedOut = (KNOCKOUT);
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
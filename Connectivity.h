@@ -0,0 +1,136 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+/****************************************************************************************************/
+/*								Connectivity of the network model									*/
+/****************************************************************************************************/
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Random_Stream.h"
+#include "Spatial_Layout.h"
+
+enum neuronType {
+    PYRAMIDAL = 0,
+    INHIBITORY,
+    THALAMOCORTICAL,
+    RETICULAR
+};
+
+/* Projections of the network given as (postsynaptic, presynaptic) population */
+static const std::vector<std::pair<neuronType, neuronType>> Projections = {
+    {PYRAMIDAL,		  PYRAMIDAL},
+    {PYRAMIDAL,		  INHIBITORY},
+    {PYRAMIDAL,		  THALAMOCORTICAL},
+    {INHIBITORY,	  PYRAMIDAL},
+    {INHIBITORY,	  INHIBITORY},
+    {INHIBITORY,	  THALAMOCORTICAL},
+    {THALAMOCORTICAL, RETICULAR},
+    {THALAMOCORTICAL, PYRAMIDAL},
+    {RETICULAR,		  THALAMOCORTICAL},
+    {RETICULAR,		  RETICULAR},
+    {RETICULAR,		  PYRAMIDAL}};
+
+/* Receptors of the synaptic variables */
+enum receptorType {
+    AMPA = 0,
+    NMDA,
+    GABA
+};
+
+/* Excitatory populations act through AMPA and NMDA, inhibitory ones through GABA receptors */
+static inline bool isExcitatory(neuronType type) {
+    return type == PYRAMIDAL || type == THALAMOCORTICAL;
+}
+
+/* Width of the connection profile of a presynaptic population in spatial units */
+static double getWidth(neuronType pre) {
+    switch (pre) {
+    case PYRAMIDAL:
+        return 250;
+    case INHIBITORY:
+        return 125;
+    case THALAMOCORTICAL:
+        return 125;
+    case RETICULAR:
+        return 125;
+    default:
+        throw std::runtime_error("Unknown connection type!");
+    }
+}
+
+/* Widths of all presynaptic populations, the defaults of the run settings */
+static std::vector<double> defaultWidths(void) {
+    return {getWidth(PYRAMIDAL), getWidth(INHIBITORY), getWidth(THALAMOCORTICAL), getWidth(RETICULAR)};
+}
+
+/* Sigma for the normal distribution of a projection with the width of its presynaptic population.
+ * On the ring it is given in units of the postsynaptic index
+ */
+static double getSigma(const Spatial_Layout& space, neuronType post, double width) {
+    extern const std::vector<int> NumCells;
+
+    if (space.layout() != RING) {
+        return width;
+    }
+    double length = 5*NumCells[PYRAMIDAL];
+    return width/length*NumCells[post];
+}
+
+/* Draw the targets of the presynaptic neuron i and pass them to target(int). As the targets only
+ * depend on the seed and i, they can be regenerated independently for every neuron. In the
+ * spatial layouts a gaussian offset is drawn around the position of neuron i and the closest
+ * postsynaptic neuron is connected, which costs O(1) per synapse
+ */
+template<typename FUNCTION>
+static void getTargets(const Spatial_Layout& space, neuronType post, neuronType pre, int i,
+                       double sigma, uint64_t seed, FUNCTION&& target) {
+    extern const std::vector<int> NumCells;
+
+    /* The number of connections and the targets are drawn from the stream of neuron i */
+    random_stream_counter RNG(seed, post*NumCells.size() + pre, i, CONNECTIVITY);
+    unsigned N_con = (abs((int)RNG.normal(20, 5)));
+    for(unsigned j=0; j < N_con; ++j) {
+        int Target;
+        /* Self connections are not allowed */
+        do {
+            if (space.layout() == RING) {
+                Target = ((int)RNG.normal(0, sigma)+i)%NumCells[post];
+                if(Target < 0) {
+                    Target += NumCells[post];
+                }
+            } else {
+                point p = space.position(pre, i);
+                p.x += RNG.normal(0, sigma);
+                p.y += RNG.normal(0, sigma);
+                if (space.layout() == COLUMN) {
+                    p.z += RNG.normal(0, sigma);
+                }
+                Target = space.nearest(post, p);
+            }
+        } while (Target == i && pre == post);
+        target(Target);
+    }
+}
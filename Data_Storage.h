@@ -24,8 +24,14 @@
 /*									Functions for data storage										*/
 /****************************************************************************************************/
 #pragma once
+#include <algorithm>
 #include <vector>
 
+#include "Connectivity.h"
+#include "Network_Image.h"
+#include "Simd_Lanes.h"
+#include "Thread_Placement.h"
+
 #include "Inhibitory_Neuron.h"
 #include "Pyramidal_Neuron.h"
 #include "Reticular_Neuron.h"
@@ -40,24 +46,60 @@ inline void get_data(int counter,
                      std::vector<Thalamocortical_Neuron>& TC,
                      std::vector<Reticular_Neuron>& RE,
                      std::vector<double*> pData) {
-    /* Parameters for the parallelization */
-    extern const int N_Cores;
-
     /* NOTE As C++ and Matlab have a different storage order (Row-major vs Column-major), the index
      * has to be adapted! For an NxM matrix A, element A(i,j) is accessed by A(j+i*M) rather than
-     * the usual A(i+j*N)
+     * the usual A(i+j*N). In an ensemble the trials of every neuron follow each other, as they do
+     * in the lanes of the neurons
      */
-    #pragma omp parallel for num_threads(N_Cores) schedule(dynamic)
+    #pragma omp parallel for num_threads(runThreads()) schedule(static)
     for(unsigned i=0; i < PY.size(); i++)
-        pData[0][i+PY.size()*counter] = PY[i].Vs[0];
+        PY[i].Vs[0].store(pData[0] + (i+PY.size()*counter)*Lanes);
 
-    #pragma omp parallel for num_threads(N_Cores) schedule(dynamic)
+    #pragma omp parallel for num_threads(runThreads()) schedule(static)
     for(unsigned i=0; i < IN.size(); i++)
-        pData[1][i+IN.size()*counter] = IN[i].V [0];
+        IN[i].V [0].store(pData[1] + (i+IN.size()*counter)*Lanes);
 
-    #pragma omp parallel for num_threads(N_Cores) schedule(dynamic)
+    #pragma omp parallel for num_threads(runThreads()) schedule(static)
     for(unsigned i=0; i < PY.size(); i++)
-        pData[2][i+PY.size()*counter] = PY[i].Ca[0];
+        PY[i].Ca[0].store(pData[2] + (i+PY.size()*counter)*Lanes);
+}
+/****************************************************************************************************/
+/*										 		end													*/
+/****************************************************************************************************/
+
+
+/****************************************************************************************************/
+/*										Restore neuron order										*/
+/****************************************************************************************************/
+/* Permute the recorded data of numSteps time steps from the simulated order of the neurons back to
+ * the order in which they were generated. The trials of an ensemble move with their neuron. Does
+ * nothing if the network has not been renumbered
+ */
+inline void restoreNeuronOrder(const Network_Image& image, std::vector<double*> pData, int numSteps,
+                               int trials = 1) {
+    if (!image.renumbered()) {
+        return;
+    }
+
+    /* Populations of the recorded variables, see get_data */
+    const int populations[3] = {PYRAMIDAL, INHIBITORY, PYRAMIDAL};
+    for (unsigned k=0; k < pData.size() && k < 3; ++k) {
+        const int numCells = image.numCells(populations[k]);
+        const int32_t* ids = image.identities(populations[k]);
+        #pragma omp parallel num_threads(runThreads())
+        {
+            std::vector<double> row((size_t)numCells*trials);
+            #pragma omp for schedule(static)
+            for (int t=0; t < numSteps; ++t) {
+                double* data = pData[k] + row.size()*t;
+                for (int i=0; i < numCells; ++i) {
+                    std::copy(data + (size_t)i*trials, data + (size_t)(i + 1)*trials,
+                              row.begin() + (size_t)ids[i]*trials);
+                }
+                std::copy(row.begin(), row.end(), data);
+            }
+        }
+    }
 }
 /****************************************************************************************************/
 /*										 		end													*/
@@ -0,0 +1,109 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+/****************************************************************************************************/
+/*							Dense connectivity of a projection										*/
+/****************************************************************************************************/
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "Network_Image.h"
+
+/* NOTE Small or densely connected projections are cheaper as a dense matrix of synapse counts
+ * than through the CSR rows, as every row is a unit stride dot product with the presynaptic
+ * variables, which stay in cache. Row j holds the number of synapses from every presynaptic
+ * neuron onto neuron j. The dot product keeps a partial sum per lane, so the input differs from
+ * the CSR sum in the last bits.
+ */
+class Dense_Matrix {
+public:
+    Dense_Matrix() = default;
+
+    /* Whether a projection can be represented densely. The number of synapses between two neurons
+     * is stored in a byte
+     */
+    static bool applicable(const Network_Image& image, int proj) {
+        return image.maxMultiplicity(proj) <= 255;
+    }
+
+    /* Matrix of the rows [first, last) of a projection, which are owned by this rank */
+    Dense_Matrix(const Network_Image& image, int proj, int first, int last)
+    : numPre  (image.numCells(image.pre(proj))),
+      rowBegin(first) {
+        weights.assign((uint64_t)(last - first)*numPre, 0);
+        for (int j=first; j < last; ++j) {
+            for (int i : image.inputs(proj, j)) {
+                weights[(uint64_t)(j - rowBegin)*numPre + i]++;
+            }
+        }
+    }
+
+    uint64_t bytes(void) const {return weights.size()*sizeof(uint8_t);}
+
+    /* Add the input of the postsynaptic neurons [first, last) to in[0, last-first) for up to two
+     * synaptic variables
+     */
+    void accumulate(int first, int last, const double* s_A, const double* s_B,
+                    double* in_A, double* in_B) const {
+        for (int j=first; j < last; ++j) {
+            const uint8_t* w = weights.data() + (uint64_t)(j - rowBegin)*numPre;
+            in_A[j - first] += dot(w, s_A);
+            if (s_B) {
+                in_B[j - first] += dot(w, s_B);
+            }
+        }
+    }
+
+private:
+    static const int Lanes = 8;
+
+    /* Dot product of a row with the presynaptic variables. The partial sums of the lanes are kept
+     * separately, which the compiler maps onto vector registers
+     */
+    double dot(const uint8_t* w, const double* s) const {
+        double partial[Lanes] = {0.0};
+        int i = 0;
+        for (; i + Lanes <= numPre; i += Lanes) {
+            for (int l=0; l < Lanes; ++l) {
+                partial[l] += w[i + l]*s[i + l];
+            }
+        }
+        for (; i < numPre; ++i) {
+            partial[0] += w[i]*s[i];
+        }
+        double sum = 0.0;
+        for (int l=0; l < Lanes; ++l) {
+            sum += partial[l];
+        }
+        return sum;
+    }
+
+    int						numPre	 = 0;
+    int						rowBegin = 0;	/* First owned postsynaptic neuron	*/
+    std::vector<uint8_t>	weights;	/* Number of synapses, row major	*/
+};
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
@@ -0,0 +1,375 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+/****************************************************************************************************/
+/*						Decomposition of the network across processes								*/
+/****************************************************************************************************/
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define DOMAIN_SHARED_MEMORY
+#endif
+
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+
+#include "Connectivity.h"
+#include "Network_Image.h"
+
+/* NOTE Every population is split into contiguous blocks of its ring, one per rank. A rank only
+ * simulates the neurons it owns, but holds an array of the synaptic variables of every population,
+ * which is indexed by the global neuron index. After the owned entries have been written for a RK
+ * step, exchange() makes the entries that are read by other ranks available to them. The network
+ * image of a rank only holds the CSR rows of the neurons it owns:
+ *
+ *	SHARED_MEMORY	The ranks are forked processes on one node. The arrays live in a shared
+ *					segment, so a barrier suffices. They are double buffered by the parity of the
+ *					RK step, so that no rank overwrites values that another one still reads.
+ *	MESSAGE_PASSING	Compiled with USE_MPI. Every rank sends exactly the entries, that the CSR rows
+ *					of the neurons owned by its peers refer to (the halo).
+ */
+class Domain {
+public:
+    enum transport {
+        SINGLE = 0,
+        SHARED_MEMORY,
+        MESSAGE_PASSING
+    };
+
+    /* Start numRanks processes. As the ranks are forked, this has to happen before any parallel
+     * region. With USE_MPI the ranks are given by the MPI launcher instead
+     */
+    explicit Domain(int numRanks = 1) {
+        extern const std::vector<int> NumCells;
+        numCells = NumCells;
+#ifdef USE_MPI
+        (void)numRanks;		/* The launcher sets the number of ranks */
+        int initialized;
+        MPI_Initialized(&initialized);
+        if (!initialized) {
+            int provided;
+            MPI_Init_thread(nullptr, nullptr, MPI_THREAD_FUNNELED, &provided);
+            ownsMPI = true;
+        }
+        MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+        MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+        mode = ranks > 1 ? MESSAGE_PASSING : SINGLE;
+        layoutStorage(1);
+        local.assign(storageSize, 0.0);
+        storage = local.data();
+#else
+        if (numRanks > 1) {
+            launch(numRanks);
+        } else {
+            layoutStorage(1);
+            local.assign(storageSize, 0.0);
+            storage = local.data();
+        }
+#endif
+    }
+
+    Domain(const Domain&) = delete;
+    Domain& operator=(const Domain&) = delete;
+
+    ~Domain() {
+#ifdef DOMAIN_SHARED_MEMORY
+        if (mode == SHARED_MEMORY) {
+            for (pid_t child : children) {
+                waitpid(child, nullptr, 0);
+            }
+            if (myRank == 0) {
+                pthread_barrier_destroy(sharedBarrier);
+            }
+            munmap(segment, segmentSize);
+        }
+#endif
+#ifdef USE_MPI
+        if (ownsMPI) {
+            MPI_Finalize();
+        }
+#endif
+    }
+
+    int		rank		(void) const {return myRank;}
+    int		size		(void) const {return ranks;}
+    bool	distributed	(void) const {return mode != SINGLE;}
+
+    /* Range of neurons of a population that is owned by this rank */
+    int first(int type) const {return (int64_t)numCells[type]* myRank     /ranks;}
+    int last (int type) const {return (int64_t)numCells[type]*(myRank + 1)/ranks;}
+
+    /* Rank that owns neuron i of a population */
+    int owner(int type, int i) const {
+        int r = (int64_t)i*ranks/numCells[type];
+        while ((int64_t)numCells[type]*(r + 1)/ranks <= i) {
+            ++r;
+        }
+        while ((int64_t)numCells[type]*r/ranks > i) {
+            --r;
+        }
+        return r;
+    }
+
+    /* Synaptic variables of all neurons of a population for RK steps of the given parity */
+    double* outputs(int type, receptorType receptor, int parity) {
+        const int buffer = mode == SHARED_MEMORY ? parity & 1 : 0;
+        return storage + offsets[type][receptor] + buffer*numCells[type];
+    }
+
+    /* Synchronize all ranks */
+    void barrier(void) {
+#ifdef DOMAIN_SHARED_MEMORY
+        if (mode == SHARED_MEMORY) {
+            pthread_barrier_wait(sharedBarrier);
+        }
+#endif
+#ifdef USE_MPI
+        if (mode == MESSAGE_PASSING) {
+            MPI_Barrier(MPI_COMM_WORLD);
+        }
+#endif
+    }
+
+    /* Determine the halo of this rank from the connectivity of the neurons it owns */
+    void setupHalo(const Network_Image& image) {
+#ifdef USE_MPI
+        if (mode != MESSAGE_PASSING) {
+            return;
+        }
+        const int numTypes = numCells.size();
+        recvList.assign(ranks, std::vector<std::vector<int>>(numTypes));
+        sendList.assign(ranks, std::vector<std::vector<int>>(numTypes));
+        for (int type=0; type < numTypes; ++type) {
+            std::vector<char> needed(numCells[type], 0);
+            for (int proj=0; proj < image.numProjections(); ++proj) {
+                if (image.pre(proj) != type) {
+                    continue;
+                }
+                const int post = image.post(proj);
+                for (int j=first(post); j < last(post); ++j) {
+                    for (int i : image.inputs(proj, j)) {
+                        needed[i] = 1;
+                    }
+                }
+            }
+            for (int i=0; i < numCells[type]; ++i) {
+                if (needed[i] && (i < first(type) || i >= last(type))) {
+                    recvList[owner(type, i)][type].push_back(i);
+                }
+            }
+
+            /* Tell every owner which of its neurons are needed */
+            std::vector<int> recvCount(ranks), sendCount(ranks), recvDispl(ranks), sendDispl(ranks);
+            std::vector<int> requested;
+            for (int r=0; r < ranks; ++r) {
+                recvCount[r] = recvList[r][type].size();
+                recvDispl[r] = requested.size();
+                requested.insert(requested.end(), recvList[r][type].begin(), recvList[r][type].end());
+            }
+            MPI_Alltoall(recvCount.data(), 1, MPI_INT, sendCount.data(), 1, MPI_INT, MPI_COMM_WORLD);
+            int total = 0;
+            for (int r=0; r < ranks; ++r) {
+                sendDispl[r] = total;
+                total += sendCount[r];
+            }
+            std::vector<int> provided(total);
+            MPI_Alltoallv(requested.data(), recvCount.data(), recvDispl.data(), MPI_INT,
+                          provided.data(), sendCount.data(), sendDispl.data(), MPI_INT,
+                          MPI_COMM_WORLD);
+            for (int r=0; r < ranks; ++r) {
+                sendList[r][type].assign(provided.begin() + sendDispl[r],
+                                         provided.begin() + sendDispl[r] + sendCount[r]);
+            }
+        }
+        sendBuffer.assign(ranks, std::vector<double>());
+        recvBuffer.assign(ranks, std::vector<double>());
+        for (int r=0; r < ranks; ++r) {
+            for (int type=0; type < numTypes; ++type) {
+                const int values = isExcitatory((neuronType)type) ? 2 : 1;
+                sendBuffer[r].resize(sendBuffer[r].size() + values*sendList[r][type].size());
+                recvBuffer[r].resize(recvBuffer[r].size() + values*recvList[r][type].size());
+            }
+        }
+#else
+        (void)image;
+#endif
+    }
+
+    /* Make the synaptic variables of the owned neurons available to all ranks that need them */
+    void exchange(int parity) {
+        if (mode == SHARED_MEMORY) {
+            barrier();
+        }
+#ifdef USE_MPI
+        if (mode != MESSAGE_PASSING) {
+            return;
+        }
+        const int numTypes = numCells.size();
+        std::vector<MPI_Request> requests;
+        for (int r=0; r < ranks; ++r) {
+            if (!recvBuffer[r].empty()) {
+                requests.emplace_back();
+                MPI_Irecv(recvBuffer[r].data(), recvBuffer[r].size(), MPI_DOUBLE, r, 0,
+                          MPI_COMM_WORLD, &requests.back());
+            }
+        }
+        for (int r=0; r < ranks; ++r) {
+            if (sendBuffer[r].empty()) {
+                continue;
+            }
+            double* value = sendBuffer[r].data();
+            for (int type=0; type < numTypes; ++type) {
+                forEachReceptor(type, [&](receptorType receptor) {
+                    const double* out = outputs(type, receptor, parity);
+                    for (int i : sendList[r][type]) {
+                        *value++ = out[i];
+                    }
+                });
+            }
+            requests.emplace_back();
+            MPI_Isend(sendBuffer[r].data(), sendBuffer[r].size(), MPI_DOUBLE, r, 0,
+                      MPI_COMM_WORLD, &requests.back());
+        }
+        MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+        for (int r=0; r < ranks; ++r) {
+            const double* value = recvBuffer[r].data();
+            for (int type=0; type < numTypes; ++type) {
+                forEachReceptor(type, [&](receptorType receptor) {
+                    double* out = outputs(type, receptor, parity);
+                    for (int i : recvList[r][type]) {
+                        out[i] = *value++;
+                    }
+                });
+            }
+        }
+#else
+        (void)parity;
+#endif
+    }
+
+private:
+    /* Synaptic variables of a population */
+    template<typename FUNCTION>
+    static void forEachReceptor(int type, FUNCTION&& f) {
+        if (isExcitatory((neuronType)type)) {
+            f(AMPA);
+            f(NMDA);
+        } else {
+            f(GABA);
+        }
+    }
+
+    /* Offsets of the arrays of every population and receptor within the storage */
+    void layoutStorage(int buffers) {
+        offsets.assign(numCells.size(), std::vector<uint64_t>(3, 0));
+        storageSize = 0;
+        for (unsigned type=0; type < numCells.size(); ++type) {
+            forEachReceptor(type, [&](receptorType receptor) {
+                offsets[type][receptor] = storageSize;
+                storageSize += (uint64_t)buffers*numCells[type];
+            });
+        }
+    }
+
+    /* Create the shared segment and fork the ranks */
+    void launch(int numRanks) {
+#ifdef DOMAIN_SHARED_MEMORY
+        mode  = SHARED_MEMORY;
+        ranks = numRanks;
+        layoutStorage(2);
+        const uint64_t header = (sizeof(pthread_barrier_t) + 63) & ~uint64_t(63);
+        segmentSize = header + storageSize*sizeof(double);
+        segment = mmap(nullptr, segmentSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (segment == MAP_FAILED) {
+            throw std::runtime_error("Could not allocate the shared memory segment!");
+        }
+        sharedBarrier = static_cast<pthread_barrier_t*>(segment);
+        storage = reinterpret_cast<double*>(static_cast<char*>(segment) + header);
+
+        pthread_barrierattr_t attr;
+        pthread_barrierattr_init(&attr);
+        pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_barrier_init(sharedBarrier, &attr, ranks);
+        pthread_barrierattr_destroy(&attr);
+
+        /* Flush the output buffers, as they would be duplicated otherwise */
+        std::cout.flush();
+        fflush(stdout);
+        for (int r=1; r < ranks; ++r) {
+            pid_t pid = fork();
+            if (pid < 0) {
+                throw std::runtime_error("Could not start the ranks!");
+            }
+            if (pid == 0) {
+                myRank = r;
+                children.clear();
+                return;
+            }
+            children.push_back(pid);
+        }
+#else
+        (void)numRanks;
+        throw std::runtime_error("Shared memory ranks are not supported on this platform!");
+#endif
+    }
+
+    transport			mode	= SINGLE;
+    int					myRank	= 0;
+    int					ranks	= 1;
+    std::vector<int>	numCells;
+
+    /* Synaptic variables of all populations */
+    std::vector<std::vector<uint64_t>>	offsets;
+    uint64_t							storageSize = 0;
+    double*								storage		= nullptr;
+    std::vector<double>					local;
+
+#ifdef DOMAIN_SHARED_MEMORY
+    void*				segment		  = nullptr;
+    uint64_t			segmentSize	  = 0;
+    pthread_barrier_t*	sharedBarrier = nullptr;
+    std::vector<pid_t>	children;
+#endif
+
+#ifdef USE_MPI
+    bool	ownsMPI = false;
+    /* Neurons sent to and received from every rank, per population */
+    std::vector<std::vector<std::vector<int>>>	sendList, recvList;
+    std::vector<std::vector<double>>			sendBuffer, recvBuffer;
+#endif
+};
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
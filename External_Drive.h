@@ -0,0 +1,248 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+
+/****************************************************************************************************/
+/*								External drive of the neurons										*/
+/****************************************************************************************************/
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "Connectivity.h"
+#include "Domain_Decomposition.h"
+#include "Network_Image.h"
+#include "Random_Stream.h"
+#include "Simd_Lanes.h"
+#include "Thread_Placement.h"
+
+/* NOTE The external drive is a current I_ext per neuron, that is updated once per time step and
+ * held over the RK steps. It is either shot noise of a Poisson spike train, where every input
+ * spike adds the weight to a current that decays with tau, or an Ornstein-Uhlenbeck current with
+ * the given mean, standard deviation and correlation time. Both are updated exactly as
+ *
+ *		I(t+dt) = decay*I(t) + offset + x(t),	decay = exp(-dt/tau)
+ *
+ * with x either weight times the number of input spikes or sigma*sqrt(1-decay^2) times a normal
+ * number. The noise x is drawn from the counter based streams of every neuron, so it does not
+ * depend on the number of threads or ranks nor on the numbering of the neurons. The trials of an
+ * ensemble draw from separate streams of their neuron, keyed by (trial, id). Every thread
+ * generates the noise of its block of neurons for many steps at once into a buffer that stays in
+ * cache, and the update of a step only streams through it.
+ */
+enum driveMode {
+    DRIVE_NONE = 0,		/* No external drive											*/
+    DRIVE_POISSON,		/* Shot noise of Poisson input spikes							*/
+    DRIVE_OU			/* Ornstein-Uhlenbeck current noise								*/
+};
+
+/* External drive of a population */
+struct driveSettings {
+    driveMode	mode;
+    double		rate;	/* Rate of the Poisson input spikes in Hz						*/
+    double		weight;	/* Current of a single input spike in muA/cm^2					*/
+    double		mean;	/* Mean of the OU current in muA/cm^2							*/
+    double		sigma;	/* Standard deviation of the OU current in muA/cm^2				*/
+    double		tau;	/* Decay time constant of the current in ms						*/
+};
+
+class External_Drive {
+public:
+    /* Drive the owned neurons of every population in every trial of an ensemble */
+    void setup(const std::vector<driveSettings>& drive, const Network_Image& image, Domain& domain,
+               int numTrials = 1) {
+        extern const double dt;
+        extern const int N_Cores;
+        seed	= image.seed();
+        step	= 0;
+        trials	= numTrials;
+        for (int type=0; type < 4; ++type) {
+            settings[type] = type < (int)drive.size() ? drive[type] : driveSettings{DRIVE_NONE, 0.0, 0.0, 0.0, 0.0, 1.0};
+            if (type >= image.numPopulations()) {
+                settings[type].mode = DRIVE_NONE;
+            }
+            const driveSettings& s = settings[type];
+            decay[type]	= s.mode == DRIVE_NONE ? 0.0 : std::exp(-dt/s.tau);
+            lambda[type]= 1E-3*s.rate*dt;
+            if (s.mode == DRIVE_POISSON) {
+                offset[type] = 0.0;
+                scale [type] = s.weight;
+            } else if (s.mode == DRIVE_OU) {
+                offset[type] = s.mean*(1.0 - decay[type]);
+                scale [type] = s.sigma*std::sqrt(1.0 - decay[type]*decay[type]);
+            }
+
+            /* The currents of every neuron and trial start at their stationary mean */
+            const int numCells = s.mode == DRIVE_NONE ? 0 : domain.last(type) - domain.first(type);
+            const double start = s.mode == DRIVE_POISSON ? s.weight*lambda[type]/(1.0 - decay[type])
+                                                         : s.mean;
+            firstTouch(current[type], numCells*trials);
+            current[type].assign(numCells*trials, start);
+            identities[type].clear();
+            for (int i=0; i < numCells; ++i) {
+                identities[type].push_back(image.identities(type)[domain.first(type) + i]);
+            }
+        }
+        buffers.assign(N_Cores, threadBuffer());
+    }
+
+    bool active(void) const {
+        for (const driveSettings& s : settings) {
+            if (s.mode != DRIVE_NONE) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* Set the drive of the neurons of a population for the current time step. Every thread
+     * updates its block of neurons with all their lanes, the loop has no barrier
+     */
+    template<class NEURON>
+    void apply(std::vector<NEURON>& neurons, neuronType type) {
+        if (settings[type].mode == DRIVE_NONE) {
+            return;
+        }
+        int begin, end;
+        staticBlock(neurons.size(), begin, end);
+        begin *= Lanes;
+        end	  *= Lanes;
+        threadBuffer& local = buffers[threadNum()];
+        if (step < local.first[type] || step >= local.first[type] + local.steps[type]
+            || begin != local.begin[type] || end != local.end[type]) {
+            refill(local, type, begin, end);
+        }
+
+        const int n = end - begin;
+        const double* x = local.noise[type].data() + (step - local.first[type])*n;
+        const double d = decay[type], o = offset[type];
+        double* I = current[type].data() + begin;
+        #pragma omp simd
+        for (int k=0; k < n; ++k) {
+            I[k] = d*I[k] + o + x[k];
+        }
+        for (int k=0; k < n; k += Lanes) {
+            neurons[(begin + k)/Lanes].I_ext = lane::load(I + k);
+        }
+    }
+
+    /* Move on to the next time step */
+    void advance(void) {++step;}
+
+    /* Continue at the given time step. The buffers are keyed by the time step, so they stay valid */
+    void seek(int64_t to) {step = to;}
+
+private:
+    /* Size of the noise buffer of a thread and population */
+    static const int BufferBytes = 16 << 10;
+    static const int MaxSteps	 = 1024;
+
+    /* Noise of the lanes [begin, end) of a thread for the steps [first, first+steps), stored
+     * by time step
+     */
+    struct threadBuffer {
+        std::vector<double>	noise[4];
+        int64_t				first[4] = {0, 0, 0, 0};
+        int					steps[4] = {0, 0, 0, 0};
+        int					begin[4] = {0, 0, 0, 0};
+        int					end	 [4] = {0, 0, 0, 0};
+        std::vector<double>	uniforms;	/* Uniform numbers of a lane during refill		*/
+    };
+
+    /* Generate the noise of the following steps. The uniform numbers of a neuron are generated in
+     * a vectorized block first, every Philox block provides the noise of two time steps
+     */
+    void refill(threadBuffer& local, int type, int begin, int end) {
+        const int n = std::max(end - begin, 1);
+        const int steps = 2*std::max(1, std::min((int)MaxSteps, BufferBytes/(int)sizeof(double)/n)/2);
+        local.first[type]	= step - step % 2;
+        local.steps[type]	= steps;
+        local.begin[type]	= begin;
+        local.end  [type]	= end;
+        std::vector<double>& noise = local.noise[type];
+        noise.resize((uint64_t)steps*n);
+        local.uniforms.resize(steps);
+
+        const uint32_t pair = local.first[type]/2;
+        const double p0 = std::exp(-lambda[type]);
+        for (int k=0; k < end - begin; ++k) {
+            const uint32_t id	 = identities[type][(begin + k)/trials];
+            const uint32_t trial = (begin + k) % trials;
+            double* u = local.uniforms.data();
+            random_stream_counter::uniformBlock(seed, type, id, trialPurpose(DRIVE, trial), pair,
+                                                steps, u);
+
+            if (settings[type].mode == DRIVE_POISSON) {
+                for (int s=0; s < steps; ++s) {
+                    noise[(uint64_t)s*n + k] = scale[type]*poissonCount(u[s], lambda[type], p0);
+                }
+            } else {
+                for (int p=0; p < steps/2; ++p) {
+                    const double radius = scale[type]*std::sqrt(-2.0*std::log(u[2*p]));
+                    const double angle  = 2.0*3.14159265358979323846*u[2*p+1];
+                    noise[(uint64_t)(2*p)*n + k]	 = radius*std::cos(angle);
+                    noise[(uint64_t)(2*p+1)*n + k] = radius*std::sin(angle);
+                }
+            }
+        }
+    }
+
+    static int threadNum(void) {
+#ifdef _OPENMP
+        return omp_get_thread_num();
+#else
+        return 0;
+#endif
+    }
+
+    /* Number of spikes by inversion of the Poisson distribution, which is cheap as the mean
+     * number per time step is small
+     */
+    static double poissonCount(double u, double lambda, double p0) {
+        int count = 0;
+        double p = p0, cdf = p0;
+        while (u > cdf && count < 64) {
+            ++count;
+            p	*= lambda/count;
+            cdf += p;
+        }
+        return count;
+    }
+
+    driveSettings				settings[4] = {};
+    double						decay [4]	= {}, offset[4] = {}, scale[4] = {}, lambda[4] = {};
+    std::vector<double>			current[4];		/* Drive of the owned neurons and trials */
+    std::vector<uint32_t>		identities[4];	/* Generated ids of the owned neurons */
+    std::vector<threadBuffer>	buffers;
+    uint64_t					seed	= 0;
+    int64_t						step	= 0;
+    int							trials	= 1;
+};
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
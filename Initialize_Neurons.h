@@ -24,25 +24,42 @@
 #ifndef M_PI
 #define M_PI           3.14159265358979323846  /* pi */
 #endif
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <exception>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <string>
 #include <utility>
 #include <vector>
 
+#include "Connectivity.h"
+#include "Network_Image.h"
 #include "Random_Stream.h"
+#include "Renumbering.h"
 #include "Inhibitory_Neuron.h"
 #include "Pyramidal_Neuron.h"
 #include "Reticular_Neuron.h"
+#include "Synaptic_Input.h"
 #include "Thalamocortical_Neuron.h"
+#include "Warm_Start.h"
 
-enum neuronType {
-    PYRAMIDAL = 0,
-    INHIBITORY,
-    THALAMOCORTICAL,
-    RETICULAR
-};
+/* Revision of the network generator. Has to be increased whenever getParameters or
+ * getTargets change, as it invalidates all cached network images
+ */
+static const uint32_t GeneratorRevision = 3;
+
+/* Number of heterogeneous parameters of every neuron type */
+static const std::vector<int> NumParameters = {3, 2, 2, 2};
 
-static std::vector<double> getParameters(neuronType Type) {
+/* Parameters of a neuron. The trials of an ensemble draw from their own streams, trial 0 gives the
+ * parameters of the network image
+ */
+static std::vector<double> getParameters(neuronType Type, int neuron, uint64_t seed, int trial = 0) {
     /* Pair containing mean and standard deviation of a gaussian distribution.*/
     std::vector<std::pair<double, double>> parameterDistribution;
 
@@ -69,160 +86,344 @@ static std::vector<double> getParameters(neuronType Type) {
         throw std::runtime_error("Unknown neuron type!");
     }
 
-    /* Initialize the random number generators */
-    std::vector<random_stream_normal> MTRand;
-    MTRand.reserve(parameterDistribution.size());
-    for (auto &dist : parameterDistribution) {
-        MTRand.push_back(random_stream_normal(dist.first, dist.second));
-    }
+    /* Every neuron has its own random stream, so neurons can be initialized in any order */
+    random_stream_counter RNG(seed, Type, neuron, trialPurpose(PARAMETERS, trial));
 
     /* Get the randomly distributed parameters */
     std::vector<double> parameter;
     parameter.reserve(parameterDistribution.size());
-    for(auto &RNG : MTRand) {
-        parameter.push_back(RNG());
+    for (auto &dist : parameterDistribution) {
+        parameter.push_back(RNG.normal(dist.first, dist.second));
     }
     return parameter;
 }
 
-template<class NEURON>
-static std::vector<NEURON> initializeNeurons(neuronType type) {
+/* First pass of the connectivity generation: count the inputs of every postsynaptic neuron in
+ * [first, last) and return the resulting CSR row offsets. The other rows stay empty
+ */
+static std::vector<uint64_t> countInputs(const Spatial_Layout& space, neuronType post,
+                                         neuronType pre, double width, uint64_t seed,
+                                         int first, int last) {
     extern const std::vector<int> NumCells;
 
-    /* Initialize the neurons */
-    std::vector<NEURON> neurons;
-    neurons.reserve(NumCells[type]);
-    for (int i = 0; i < NumCells[type]; ++i) {
-        neurons.push_back(NEURON(getParameters(type)));
+    const double sigma = getSigma(space, post, width);
+    std::vector<uint64_t> rows(NumCells[post] + 1, 0);
+    uint64_t* count = rows.data() + 1;
+    #pragma omp parallel for num_threads(runThreads()) schedule(static)
+    for (int i=0; i < NumCells[pre]; ++i) {
+        getTargets(space, post, pre, i, sigma, seed, [count, first, last](int Target) {
+            if (Target >= first && Target < last) {
+                #pragma omp atomic
+                count[Target]++;
+            }
+        });
     }
-    return neurons;
+    for (int j=0; j < NumCells[post]; ++j) {
+        rows[j+1] += rows[j];
+    }
+    return rows;
 }
 
-static std::vector<std::vector<int>> getConnectivity(neuronType post, neuronType pre) {
-    using connectome = std::vector<std::vector<int>>;
-    extern const std::vector<int> NumCells;
+/* Second pass of the connectivity generation: write the presynaptic neurons of the rows
+ * [first, last) into the CSR arrays of the image. Every row is sorted afterwards, so the result
+ * does not depend on the scheduling
+ */
+static void fillInputs(const Spatial_Layout& space, Network_Image& image, int proj,
+                       double width, uint64_t seed, int first, int last) {
 
-    double length = 5*NumCells[PYRAMIDAL];
-    /* Sigma for the normal distribution */
-    double sigma;
-    switch (pre) {
-    case PYRAMIDAL:
-        sigma = 250/length*NumCells[post];
-        break;
-    case INHIBITORY:
-        sigma = 125/length*NumCells[post];
-        break;
-    case THALAMOCORTICAL:
-        sigma = 125/length*NumCells[post];
-        break;
-    case RETICULAR:
-        sigma = 125/length*NumCells[post];
-        break;
-    default:
-        throw std::runtime_error("Unknown connection type!");
+    const neuronType post = (neuronType)image.post(proj);
+    const neuronType pre  = (neuronType)image.pre (proj);
+    const double sigma = getSigma(space, post, width);
+    const uint64_t* rows    = image.rows(proj);
+    int32_t*		indices = image.indices(proj);
+
+    std::vector<uint64_t> cursor(rows, rows + image.numCells(post));
+    uint64_t* next = cursor.data();
+    #pragma omp parallel for num_threads(runThreads()) schedule(static)
+    for (int i=0; i < image.numCells(pre); ++i) {
+        getTargets(space, post, pre, i, sigma, seed, [next, indices, i, first, last](int Target) {
+            if (Target >= first && Target < last) {
+                uint64_t position;
+                #pragma omp atomic capture
+                position = next[Target]++;
+                indices[position] = i;
+            }
+        });
     }
 
-    /* Generate the random number generator for the number of connections */
-    random_stream_normal MTRand_N  = random_stream_normal(20, 5);
+    #pragma omp parallel for num_threads(runThreads()) schedule(static)
+    for (int j=first; j < last; ++j) {
+        std::sort(indices + rows[j], indices + rows[j+1]);
+    }
+}
+
+/* Hash of all settings that determine the generated network, including the connection widths */
+static uint64_t getConfigHash(const std::vector<double>& width) {
+    extern const std::vector<int> NumCells;
+    extern const bool ProceduralConnectivity;
+    extern const networkLayout Layout;
+    extern const neuronOrdering Ordering;
+    uint64_t hash = hash_bytes(&GeneratorRevision, sizeof(GeneratorRevision));
+    hash = hash_bytes(&ProceduralConnectivity, sizeof(ProceduralConnectivity), hash);
+    hash = hash_bytes(&Layout, sizeof(Layout), hash);
+    hash = hash_bytes(&Ordering, sizeof(Ordering), hash);
+    hash = hash_bytes(NumCells.data(), NumCells.size()*sizeof(int), hash);
+    hash = hash_bytes(width.data(), width.size()*sizeof(double), hash);
+    return hash_bytes(NumParameters.data(), NumParameters.size()*sizeof(int), hash);
+}
 
-    /* Generate the random number generator for the target neurons */
-    random_stream_normal MTRand_T = random_stream_normal(0, sigma);
+/* Generate the parameters and connectivity of a new network with the given connection widths.
+ * Only the CSR rows of the neurons [first[type], last[type]) are generated, which gives the partial
+ * image of a rank. With procedural connectivity the synapses are regenerated during the simulation
+ * and not stored in the image, so the neurons keep the generated order
+ */
+static Network_Image generateNetwork(uint64_t seed, const std::vector<double>& width,
+                                     const std::vector<int>& first, const std::vector<int>& last) {
+    extern const std::vector<int> NumCells;
+    extern const bool ProceduralConnectivity;
+    extern const networkLayout Layout;
+    extern const neuronOrdering Ordering;
+    const Spatial_Layout space(Layout, NumCells, seed);
 
-    connectome connectivity(NumCells[post], std::vector<int>(0));
-    for (int i=0; i < NumCells[pre]; ++i) {
-        unsigned N_con = (abs((int)MTRand_N()));
-        for(unsigned j=0; j < N_con; ++j) {
-            int Target;
-            /* Self connections are not allowed */
-            do {
-                Target = ((int)MTRand_T()+i)%NumCells[post];
-                if(Target < 0) {
-                    Target += NumCells[post];
-                }
-            } while (Target == i && pre == post);
-            connectivity[Target].push_back(i);
+    /* Count the synapses of every projection to lay out the image */
+    std::vector<std::vector<uint64_t>> rows;
+    std::vector<projectionLayout> layout;
+    for (const auto &proj : Projections) {
+        if (!ProceduralConnectivity) {
+            rows.push_back(countInputs(space, proj.first, proj.second, width[proj.second], seed,
+                                       first[proj.first], last[proj.first]));
+            layout.push_back({proj.first, proj.second, rows.back().back()});
         }
     }
-    return connectivity;
-}
 
-void connectNeurons(std::vector<Pyramidal_Neuron>& PY,
-                    std::vector<Inhibitory_Neuron>& IN,
-                    std::vector<Thalamocortical_Neuron>& TC,
-                    std::vector<Reticular_Neuron>& RE) {
-    using connectome = std::vector<std::vector<int>>;
-    /* Generate random connectivity matrices. For every Neuron[i] they store
-     * the index of all neurons it RECEIVES input from
-     */
-    connectome conPP = getConnectivity(PYRAMIDAL, PYRAMIDAL);
-    connectome conPI = getConnectivity(PYRAMIDAL, INHIBITORY);
-    connectome conPT = getConnectivity(PYRAMIDAL, THALAMOCORTICAL);
-    for (Pyramidal_Neuron &neuron : PY) {
-        for (int connection : conPP.at(&neuron - PY.data())) {
-            neuron.PY_Con.push_back(&PY.at(connection));
+    Network_Image image;
+    image.allocate(seed, getConfigHash(width), NumCells, NumParameters, layout);
+    if (first != std::vector<int>(NumCells.size(), 0) || last != NumCells) {
+        if (Ordering == ORDER_RCM) {
+            throw std::runtime_error("A renumbered network cannot be generated in parts!");
         }
-        for (int connection : conPI.at(&neuron - PY.data())) {
-            neuron.IN_Con.push_back(&IN.at(connection));;
-        }
-        for (int connection : conPT.at(&neuron - PY.data())) {
-            neuron.TC_Con.push_back(&TC.at(connection));
+        image.markPartial();
+    }
+    for (unsigned type=0; type < NumCells.size(); ++type) {
+        #pragma omp parallel for num_threads(runThreads()) schedule(static)
+        for (int i = 0; i < NumCells[type]; ++i) {
+            const std::vector<double> parameters = getParameters((neuronType)type, i, seed);
+            std::copy(parameters.begin(), parameters.end(), image.parameters(type, i));
         }
     }
+    for (unsigned proj=0; proj < rows.size(); ++proj) {
+        std::copy(rows[proj].begin(), rows[proj].end(), image.rows(proj));
+        fillInputs(space, image, proj, width[image.pre(proj)], seed,
+                   first[image.post(proj)], last[image.post(proj)]);
+    }
 
-    connectome conIP = getConnectivity(INHIBITORY, PYRAMIDAL);
-    connectome conII = getConnectivity(INHIBITORY, INHIBITORY);
-    connectome conIT = getConnectivity(INHIBITORY, THALAMOCORTICAL);
-    for (Inhibitory_Neuron &neuron : IN) {
-        for (int connection : conIP.at(&neuron - IN.data())) {
-            neuron.PY_Con.push_back(&PY.at(connection));
-        }
-        for (int connection : conII.at(&neuron - IN.data())) {
-            neuron.IN_Con.push_back(&IN.at(connection));;
-        }
-        for (int connection : conIT.at(&neuron - IN.data())) {
-            neuron.TC_Con.push_back(&TC.at(connection));
-        }
+    /* Renumber the neurons for locality */
+    if (Ordering == ORDER_RCM && !ProceduralConnectivity) {
+        image = renumberNetwork(image, orderReverseCuthillMcKee(image));
     }
+    return image;
+}
 
-    connectome conTR = getConnectivity(THALAMOCORTICAL, RETICULAR);
-    connectome conTP = getConnectivity(THALAMOCORTICAL, PYRAMIDAL);
-    for (Thalamocortical_Neuron &neuron : TC) {
-        for (int connection : conTP.at(&neuron - TC.data())) {
-            neuron.PY_Con.push_back(&PY.at(connection));
-        }
-        for (int connection : conTR.at(&neuron - TC.data())) {
-            neuron.RE_Con.push_back(&RE.at(connection));;
+static Network_Image generateNetwork(uint64_t seed, const std::vector<double>& width) {
+    extern const std::vector<int> NumCells;
+    return generateNetwork(seed, width, std::vector<int>(NumCells.size(), 0), NumCells);
+}
+
+/* Generate a network and write its image to disk */
+void exportNetwork(const std::string& file, uint64_t seed,
+                   const std::vector<double>& width = defaultWidths()) {
+    generateNetwork(seed, width).save(file);
+}
+
+/* Map the network image for the current settings from the cache directory or generate it if it
+ * does not exist yet. An empty cache directory disables the cache
+ */
+static Network_Image getNetwork(uint64_t seed, const std::vector<double>& width) {
+    extern const std::string NetworkCache;
+    const uint64_t configHash = getConfigHash(width);
+    if (NetworkCache.empty()) {
+        return generateNetwork(seed, width);
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "/network_%016llx_%llu.bin",
+             (unsigned long long)configHash, (unsigned long long)seed);
+    const std::string file = NetworkCache + name;
+
+    Network_Image image;
+    if (image.load(file) && image.configHash() == configHash && image.seed() == seed) {
+        return image;
+    }
+    image = generateNetwork(seed, width);
+    try {
+        image.save(file);
+    } catch (const std::exception&) {
+        /* The cache is only an optimization, so an unwritable directory is not an error */
+    }
+    return image;
+}
+
+/* Initialize the owned neurons of a population. In an ensemble
+ * every neuron object holds Lanes trials and the objects of the trials of a neuron follow each
+ * other. The first trial is the network of the image, trial k draws the parameters of the neurons
+ * from the stream of trial k, so the trials of different seeds never share their parameters
+ */
+template<class NEURON>
+static std::vector<NEURON> initializeNeurons(const Network_Image& image, neuronType type,
+                                             int first, int last, int trials = 1) {
+    if (trials % Lanes != 0) {
+        throw std::runtime_error("The number of trials must be a multiple of the SIMD lanes!");
+    }
+
+    /* Initialize the neurons owned by this rank in storage placed by the owning threads */
+    std::vector<NEURON> neurons;
+    firstTouch(neurons, (last - first)*(trials/Lanes));
+    const int numParameters = image.numParameters(type);
+    std::vector<double> param(numParameters*Lanes);
+    for (int i = first; i < last; ++i) {
+        for (int k=0; k < trials; ++k) {
+            const std::vector<double> trial = k == 0
+                ? std::vector<double>(image.parameters(type, i), image.parameters(type, i) + numParameters)
+                : getParameters(type, image.identities(type)[i], image.seed(), k);
+            std::copy(trial.begin(), trial.end(), param.begin() + (k % Lanes)*numParameters);
+            if (k % Lanes == Lanes - 1) {
+                neurons.push_back(NEURON(param));
+            }
         }
     }
+    return neurons;
+}
+
+/* Settings that may differ between the runs of a parameter sweep */
+struct runSettings {
+    unsigned					seed;		/* Seed of the network generation		*/
+    std::vector<driveSettings>	drive;		/* External drive of the populations	*/
+    std::vector<double>			noise;		/* Voltage noise in mV/sqrt(ms)			*/
+    std::string					stimulus;	/* Stimulus file, empty for none		*/
+    std::vector<double>			width;		/* Connection width of every presynaptic population	*/
+    populationParameters		parameters;	/* Channel conductivities of the populations	*/
+};
 
-    connectome conRT = getConnectivity(RETICULAR, THALAMOCORTICAL);
-    connectome conRR = getConnectivity(RETICULAR, RETICULAR);
-    connectome conRP = getConnectivity(RETICULAR, PYRAMIDAL);
-    for (Reticular_Neuron &neuron : RE) {
-        for (int connection : conRP.at(&neuron - RE.data())) {
-            neuron.PY_Con.push_back(&PY.at(connection));
+/* Run settings of the main file, with the widths and conductances of the model */
+inline runSettings fixedSettings(void) {
+    extern const unsigned Seed;
+    extern const std::vector<driveSettings> Drive;
+    extern const std::vector<double> VoltageNoise;
+    extern const std::string StimulusFile;
+    return {Seed, Drive, VoltageNoise, StimulusFile, defaultWidths(), populationParameters()};
+}
+
+/* Set up a run with the given settings. The threads are not pinned, as runs may share the process */
+void setupNetwork(std::vector<Pyramidal_Neuron>& PY,
+                  std::vector<Inhibitory_Neuron>& IN,
+                  std::vector<Thalamocortical_Neuron>& TC,
+                  std::vector<Reticular_Neuron>& RE,
+                  Synaptic_Input& synapses,
+                  const runSettings& settings) {
+    extern const bool ProceduralConnectivity;
+    extern const networkLayout Layout;
+    extern const std::string NetworkCache;
+    extern const gatherEngine Engine;
+    extern const propagationMode Propagation;
+    extern const double DeltaTolerance;
+    extern const int ResyncInterval;
+    extern const int Trials;
+    extern const std::vector<int> NumCells;
+    extern const neuronOrdering Ordering;
+    Domain& domain = synapses.partition();
+
+    /* Get the parameters and connectivity of the network. With a cache the first rank generates
+     * the image, which the others then load from it. Every rank only keeps the CSR rows of the
+     * neurons it owns, which it generates directly if there is neither a cache nor a renumbering */
+    std::vector<int> first(NumCells.size()), last(NumCells.size());
+    for (unsigned type=0; type < NumCells.size(); ++type) {
+        first[type] = domain.first(type);
+        last [type] = domain.last (type);
+    }
+    Network_Image image;
+    if (domain.distributed() && NetworkCache.empty() && Ordering != ORDER_RCM) {
+        image = generateNetwork(settings.seed, settings.width, first, last);
+    } else {
+        if (domain.rank() == 0) {
+            image = getNetwork(settings.seed, settings.width);
         }
-        for (int connection : conRR.at(&neuron - RE.data())) {
-            neuron.RE_Con.push_back(&RE.at(connection));;
+        if (!NetworkCache.empty()) {
+            domain.barrier();
         }
-        for (int connection : conRT.at(&neuron - RE.data())) {
-            neuron.TC_Con.push_back(&TC.at(connection));
+        if (domain.rank() != 0) {
+            image = getNetwork(settings.seed, settings.width);
+        }
+        if (domain.distributed()) {
+            image = image.slice(first, last);
         }
     }
-}
 
+    /* Initialize the individual neurons */
+    PY = initializeNeurons<Pyramidal_Neuron>(image, PYRAMIDAL, domain.first(PYRAMIDAL),
+                                             domain.last(PYRAMIDAL), Trials);
+    IN = initializeNeurons<Inhibitory_Neuron>(image, INHIBITORY, domain.first(INHIBITORY),
+                                              domain.last(INHIBITORY), Trials);
+    TC = initializeNeurons<Thalamocortical_Neuron>(image, THALAMOCORTICAL, domain.first(THALAMOCORTICAL),
+                                                   domain.last(THALAMOCORTICAL), Trials);
+    RE = initializeNeurons<Reticular_Neuron>(image, RETICULAR, domain.first(RETICULAR),
+                                             domain.last(RETICULAR), Trials);
+
+    /* The synaptic input keeps the image, as it reads the connectivity from it, and the
+     * conductances of the run, which the populations share
+     */
+    synapses.setup(std::move(image), ProceduralConnectivity, Layout, settings.width, Engine);
+    synapses.setChannels(settings.parameters);
+    synapses.setTrials(Trials);
+    if (Propagation == PROPAGATE_DELTA) {
+        synapses.propagateDeltas(DeltaTolerance, ResyncInterval);
+    }
+    synapses.setDrive(settings.drive);
+    synapses.setNoise(settings.noise);
+    Warm_Start::equilibrate(PY, IN, TC, RE, synapses, settings.drive, settings.noise);
+    if (!settings.stimulus.empty()) {
+        synapses.setStimulus(settings.stimulus);
+    }
+}
 
 void setupNetwork(std::vector<Pyramidal_Neuron>& PY,
                   std::vector<Inhibitory_Neuron>& IN,
                   std::vector<Thalamocortical_Neuron>& TC,
-                  std::vector<Reticular_Neuron>& RE) {
-    /* Initialize the individual neurons */
-    PY = initializeNeurons<Pyramidal_Neuron>(PYRAMIDAL);
-    IN = initializeNeurons<Inhibitory_Neuron>(INHIBITORY);
-    TC = initializeNeurons<Thalamocortical_Neuron>(THALAMOCORTICAL);
-    RE = initializeNeurons<Reticular_Neuron>(RETICULAR);
+                  std::vector<Reticular_Neuron>& RE,
+                  Synaptic_Input& synapses) {
+    extern const threadPinning Pinning;
+
+    /* Pin the threads before they touch any memory of the network */
+    pinThreads(Pinning, synapses.partition().rank());
+    setupNetwork(PY, IN, TC, RE, synapses, fixedSettings());
+}
 
-    connectNeurons(PY, IN, TC, RE);
+/* Memory footprint of the network. The neuron classes only hold the variables and the individual
+ * parameters, the constants and the conductances of the run are shared by the population. A
+ * rank only counts the neurons and synapses it owns
+ */
+inline void reportMemory(std::ostream& out,
+                         const std::vector<Pyramidal_Neuron>& PY,
+                         const std::vector<Inhibitory_Neuron>& IN,
+                         const std::vector<Thalamocortical_Neuron>& TC,
+                         const std::vector<Reticular_Neuron>& RE,
+                         const Synaptic_Input& synapses) {
+    auto line = [&out](const char* name, uint64_t count, uint64_t bytes) {
+        out << std::left << std::setw(12) << name << std::right
+            << std::setw(12) << count << std::setw(14) << bytes << std::fixed << std::setprecision(1)
+            << std::setw(14) << (count ? (double)bytes/count : 0.0) << "\n";
+        out.unsetf(std::ios::fixed);
+    };
+    const uint64_t numNeurons = PY.size() + IN.size() + TC.size() + RE.size();
+    const Domain& domain = synapses.partition();
+    const std::string title = domain.distributed() ? "rank " + std::to_string(domain.rank()) : "memory";
+    out << std::left << std::setw(12) << title << std::right << std::setw(12) << "count"
+        << std::setw(14) << "bytes" << std::setw(14) << "bytes/item" << "\n";
+    line("pyramidal",		PY.size(), PY.size()*sizeof(Pyramidal_Neuron));
+    line("inhibitory",		IN.size(), IN.size()*sizeof(Inhibitory_Neuron));
+    line("thalamic",		TC.size(), TC.size()*sizeof(Thalamocortical_Neuron));
+    line("reticular",		RE.size(), RE.size()*sizeof(Reticular_Neuron));
+    line("buffers",			numNeurons, synapses.bufferBytes());
+    line("synapses",		synapses.numSynapses(), synapses.connectivityBytes());
 }
 
 #endif // INITIALIZE_Neurons_H
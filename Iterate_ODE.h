@@ -23,52 +23,74 @@
 #define ODE_H
 #include <vector>
 #include "Inhibitory_Neuron.h"
+#include "Live_Monitor.h"
+#include "Profiler.h"
 #include "Pyramidal_Neuron.h"
 #include "Reticular_Neuron.h"
+#include "Synaptic_Input.h"
 #include "Thalamocortical_Neuron.h"
 
+/* Apply a function to every neuron of a population within a timed parallel region */
+template<class NEURON, typename FUNCTION>
+static void forEachNeuron(std::vector<NEURON>& neurons, profilePhase phase, FUNCTION&& function) {
+    (void)phase;
+
+    #pragma omp parallel num_threads(runThreads())
+    {
+        PROFILE_PHASE(phase);
+        #pragma omp for schedule(static) nowait
+        for(auto it = neurons.begin(); it < neurons.end(); ++it)
+            function(*it);
+    }
+}
+
+/* Add up the RK terms of a population. An active monitor accumulates the voltages and spikes of
+ * the neurons within the same pass
+ */
+template<class NEURON>
+static void addRK(std::vector<NEURON>& neurons, profilePhase phase, neuronType type, Live_Monitor* monitor) {
+    if (!monitor || !monitor->active()) {
+        forEachNeuron(neurons, phase, [](NEURON& neuron) {neuron.add_RK();});
+        return;
+    }
+    (void)phase;
+
+    #pragma omp parallel num_threads(runThreads())
+    {
+        PROFILE_PHASE(phase);
+        Live_Monitor::tally tally;
+        #pragma omp for schedule(static) nowait
+        for(auto it = neurons.begin(); it < neurons.end(); ++it)
+            Live_Monitor::advance(*it, tally);
+        monitor->accumulate(type, tally);
+    }
+}
+
 void Iterate_ODE(std::vector<Pyramidal_Neuron>& PY,
                  std::vector<Inhibitory_Neuron>& IN,
                  std::vector<Thalamocortical_Neuron>& TC,
-                 std::vector<Reticular_Neuron>& RE) {
-    /* Parameters for the parallelization */
-    extern const int N_Cores;
-
+                 std::vector<Reticular_Neuron>& RE,
+                 Synaptic_Input& synapses,
+                 Live_Monitor* monitor = nullptr) {
     /* First get all the RK terms */
+    const populationParameters& g = synapses.channels();
     for (unsigned i=0; i < 4; i++) {
-        #pragma omp parallel for num_threads(N_Cores) schedule(dynamic)
-        for(auto it = PY.begin(); it < PY.end(); ++it)
-            it->set_RK(i);
-
-        #pragma omp parallel for num_threads(N_Cores) schedule(dynamic)
-        for(auto it = IN.begin(); it < IN.end(); ++it)
-            it->set_RK(i);
-
-        #pragma omp parallel for num_threads(N_Cores) schedule(dynamic)
-        for(auto it = TC.begin(); it < TC.end(); ++it)
-            it->set_RK(i);
+        synapses.gather(i, PY, IN, TC, RE);
 
-        #pragma omp parallel for num_threads(N_Cores) schedule(dynamic)
-        for(auto it = RE.begin(); it < RE.end(); ++it)
-            it->set_RK(i);
+        forEachNeuron(PY, SET_RK_PY, [i, &g](Pyramidal_Neuron& neuron)		{neuron.set_RK(i, g.PY);});
+        forEachNeuron(IN, SET_RK_IN, [i, &g](Inhibitory_Neuron& neuron)		{neuron.set_RK(i, g.IN);});
+        forEachNeuron(TC, SET_RK_TC, [i, &g](Thalamocortical_Neuron& neuron)	{neuron.set_RK(i, g.TC);});
+        forEachNeuron(RE, SET_RK_RE, [i, &g](Reticular_Neuron& neuron)		{neuron.set_RK(i, g.RE);});
     }
 
     /* Add the RK terms up*/
-    #pragma omp parallel for num_threads(N_Cores) schedule(dynamic)
-    for(auto it = PY.begin(); it < PY.end(); ++it)
-        it->add_RK();
-
-    #pragma omp parallel for num_threads(N_Cores) schedule(dynamic)
-    for(auto it = IN.begin(); it < IN.end(); ++it)
-        it->add_RK();
-
-    #pragma omp parallel for num_threads(N_Cores) schedule(dynamic)
-    for(auto it = TC.begin(); it < TC.end(); ++it)
-        it->add_RK();
-
-    #pragma omp parallel for num_threads(N_Cores) schedule(dynamic)
-    for(auto it = RE.begin(); it < RE.end(); ++it)
-        it->add_RK();
+    addRK(PY, ADD_RK_PY, PYRAMIDAL,		  monitor);
+    addRK(IN, ADD_RK_IN, INHIBITORY,	  monitor);
+    addRK(TC, ADD_RK_TC, THALAMOCORTICAL, monitor);
+    addRK(RE, ADD_RK_RE, RETICULAR,		  monitor);
+#ifdef PROFILE_PHASES
+    profiler().fold();
+#endif
 }
 
 #endif // ODE_H
@@ -0,0 +1,181 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+
+/****************************************************************************************************/
+/*							Langevin noise on the membrane voltage									*/
+/****************************************************************************************************/
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "Connectivity.h"
+#include "Domain_Decomposition.h"
+#include "Network_Image.h"
+#include "Random_Stream.h"
+#include "Simd_Lanes.h"
+#include "Thread_Placement.h"
+
+/* NOTE The voltage equation of every neuron can carry additive white noise, dV = f(V)dt + sigma dW,
+ * with sigma in mV/sqrt(ms). It is integrated with the stochastic RK scheme for additive noise
+ * that extends the deterministic RK4 steps. With two independent normal numbers xi_1, xi_2 of
+ * variance dt per time step, RK step N adds
+ *
+ *		B[N]*sigma*(xi_1 + xi_2/sqrt(3)),	B = {0.75, 0.75, 0, 0}
+ *
+ * to the voltage and the final sum adds sigma*(xi_1 - sqrt(3)*xi_2)/4, so the increment of a time
+ * step is sigma*xi_1. Every neuron gets both terms once per time step. They are drawn from the
+ * counter based streams of the neurons like the external drive, in blocks of many time steps per
+ * thread, and every trial of an ensemble has its own stream keyed by (trial, id).
+ */
+class Langevin_Noise {
+public:
+    /* Noise amplitude of the owned neurons of every population in every trial of an ensemble */
+    void setup(const std::vector<double>& amplitude, const Network_Image& image, Domain& domain,
+               int numTrials = 1) {
+        extern const double dt;
+        extern const int N_Cores;
+        seed	= image.seed();
+        step	= 0;
+        trials	= numTrials;
+        for (int type=0; type < 4; ++type) {
+            const bool noisy = type < (int)amplitude.size() && type < image.numPopulations()
+                               && amplitude[type] != 0.0;
+            sigma[type] = noisy ? amplitude[type]*std::sqrt(dt) : 0.0;
+            identities[type].clear();
+            if (noisy) {
+                for (int i=domain.first(type); i < domain.last(type); ++i) {
+                    identities[type].push_back(image.identities(type)[i]);
+                }
+            }
+        }
+        buffers.assign(N_Cores, threadBuffer());
+    }
+
+    bool active(void) const {
+        return sigma[0] != 0.0 || sigma[1] != 0.0 || sigma[2] != 0.0 || sigma[3] != 0.0;
+    }
+
+    /* Set the noise of the neurons of a population for the current time step. Every thread sets
+     * its block of neurons with all their lanes, the loop has no barrier
+     */
+    template<class NEURON>
+    void apply(std::vector<NEURON>& neurons, neuronType type) {
+        if (sigma[type] == 0.0) {
+            return;
+        }
+        int begin, end;
+        staticBlock(neurons.size(), begin, end);
+        begin *= Lanes;
+        end	  *= Lanes;
+        threadBuffer& local = buffers[threadNum()];
+        if (step < local.first[type] || step >= local.first[type] + local.steps[type]
+            || begin != local.begin[type] || end != local.end[type]) {
+            refill(local, type, begin, end);
+        }
+
+        const double* x = local.noise[type].data() + 2*(step - local.first[type])*(end - begin);
+        for (int k=0; k < end - begin; k += Lanes) {
+            neurons[(begin + k)/Lanes].noise_RK	 = lane::load(x + 2*k, 2);
+            neurons[(begin + k)/Lanes].noise_add = lane::load(x + 2*k + 1, 2);
+        }
+    }
+
+    /* Move on to the next time step */
+    void advance(void) {++step;}
+
+    /* Continue at the given time step. The buffers are keyed by the time step, so they stay valid */
+    void seek(int64_t to) {step = to;}
+
+private:
+    /* Size of the noise buffer of a thread and population */
+    static const int BufferBytes = 16 << 10;
+    static const int MaxSteps	 = 1024;
+
+    /* Noise terms of the lanes [begin, end) of a thread for the steps [first, first+steps),
+     * stored by time step and lane
+     */
+    struct threadBuffer {
+        std::vector<double>	noise[4];
+        int64_t				first[4] = {0, 0, 0, 0};
+        int					steps[4] = {0, 0, 0, 0};
+        int					begin[4] = {0, 0, 0, 0};
+        int					end	 [4] = {0, 0, 0, 0};
+        std::vector<double>	uniforms;	/* Uniform numbers of a lane during refill		*/
+    };
+
+    /* Generate the noise of the following steps. Every Philox block provides the two normal
+     * numbers of a time step
+     */
+    void refill(threadBuffer& local, int type, int begin, int end) {
+        const int n = std::max(end - begin, 1);
+        const int steps = std::max(1, std::min((int)MaxSteps, BufferBytes/(int)(2*sizeof(double))/n));
+        local.first[type]	= step;
+        local.steps[type]	= steps;
+        local.begin[type]	= begin;
+        local.end  [type]	= end;
+        std::vector<double>& noise = local.noise[type];
+        noise.resize(2*(uint64_t)steps*n);
+        local.uniforms.resize(2*steps);
+
+        const double root3 = std::sqrt(3.0);
+        for (int k=0; k < end - begin; ++k) {
+            const uint32_t id	 = identities[type][(begin + k)/trials];
+            const uint32_t trial = (begin + k) % trials;
+            double* u = local.uniforms.data();
+            random_stream_counter::uniformBlock(seed, type, id, trialPurpose(NOISE, trial),
+                                                (uint32_t)step, 2*steps, u);
+            for (int s=0; s < steps; ++s) {
+                const double radius = sigma[type]*std::sqrt(-2.0*std::log(u[2*s]));
+                const double angle  = 2.0*3.14159265358979323846*u[2*s+1];
+                const double xi_1	= radius*std::cos(angle);
+                const double xi_2	= radius*std::sin(angle);
+                noise[2*((uint64_t)s*n + k)]	 = xi_1 + xi_2/root3;
+                noise[2*((uint64_t)s*n + k) + 1] = (xi_1 - root3*xi_2)/4;
+            }
+        }
+    }
+
+    static int threadNum(void) {
+#ifdef _OPENMP
+        return omp_get_thread_num();
+#else
+        return 0;
+#endif
+    }
+
+    double						sigma[4] = {};	/* Standard deviation per time step	*/
+    std::vector<uint32_t>		identities[4];	/* Generated ids of the owned neurons */
+    std::vector<threadBuffer>	buffers;
+    uint64_t					seed	= 0;
+    int64_t						step	= 0;
+    int							trials	= 1;
+};
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
@@ -0,0 +1,229 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+
+/****************************************************************************************************/
+/*									Live monitoring of a run										*/
+/****************************************************************************************************/
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Connectivity.h"
+#include "Inhibitory_Neuron.h"
+#include "Monitor_Buffer.h"
+#include "Pyramidal_Neuron.h"
+#include "Reticular_Neuron.h"
+#include "Simd_Lanes.h"
+#include "Thalamocortical_Neuron.h"
+
+/* NOTE The voltages and spikes are accumulated while the neurons are advanced by add_RK in
+ * Iterate_ODE, which hands every thread's tally of a population to the monitor, so monitoring does
+ * not need a pass over the neurons of its own. update() then only counts the time step and
+ * publishes a sample every interval, close() publishes the remainder of the last interval.
+ */
+class Live_Monitor {
+public:
+    Live_Monitor() = default;
+    Live_Monitor(const Live_Monitor&) = delete;
+    Live_Monitor& operator=(const Live_Monitor&) = delete;
+    ~Live_Monitor() {close();}
+
+    /* Voltages and threshold crossings of the neurons a thread advanced in a time step */
+    struct tally {
+        double		voltage = 0.0;
+        uint64_t	spikes	= 0;
+    };
+
+    /* Create the shared memory object of the given name, e.g. "/bazhenov", and publish a sample
+     * every interval time steps
+     */
+    void open(const std::string& name, int interval, uint32_t capacity = 4096) {
+        extern const double dt;
+        close();
+        if (interval < 1 || capacity < 1) {
+            throw std::runtime_error("The monitor needs a positive interval and capacity!");
+        }
+#ifdef MONITOR_SHM
+        const size_t size = sizeof(monitorHeader) + capacity*sizeof(monitorSample);
+        const int fd = shm_open(name.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0644);
+        if (fd < 0 || ftruncate(fd, size) != 0) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            throw std::runtime_error("Could not create the monitor " + name + "!");
+        }
+        void* region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (region == MAP_FAILED) {
+            throw std::runtime_error("Could not map the monitor " + name + "!");
+        }
+
+        data	= static_cast<char*>(region);
+        bytes	= size;
+        shared	= name;
+        header	= new (data) monitorHeader();
+        std::memcpy(header->magic, MonitorMagic, sizeof(header->magic));
+        header->version	 = MonitorVersion;
+        header->capacity = capacity;
+        header->interval = interval;
+        header->dt		 = dt;
+        header->finished.store(0, std::memory_order_relaxed);
+        header->written.store(0, std::memory_order_relaxed);
+        for (uint32_t s=0; s < capacity; ++s) {
+            new (&slots()[s]) monitorSample();
+            slots()[s].sequence.store(0, std::memory_order_relaxed);
+        }
+        step	= 0;
+        sampled	= 0;
+        last	= std::chrono::steady_clock::now();
+        for (int type=0; type < 4; ++type) {
+            voltage[type]	= 0.0;
+            spikes [type]	= 0;
+        }
+#else
+        throw std::runtime_error("Live monitoring needs POSIX shared memory!");
+#endif
+    }
+
+    bool active(void) const {return header != nullptr;}
+
+    /* Advance a neuron by a time step and account for every lane in the tally of the calling
+     * thread
+     */
+    template<class NEURON>
+    static void advance(NEURON& neuron, tally& t) {
+        static const double Threshold = 0.0;
+        const lane before = voltage_of(neuron);
+        neuron.add_RK();
+        const lane after = voltage_of(neuron);
+        for (int k=0; k < Lanes; ++k) {
+            t.voltage += after[k];
+            t.spikes  += before[k] < Threshold && after[k] >= Threshold;
+        }
+    }
+
+    /* Add the tally of a thread to a population */
+    void accumulate(neuronType type, const tally& t) {
+        #pragma omp atomic
+        voltage[type] += t.voltage;
+        #pragma omp atomic
+        spikes[type] += t.spikes;
+    }
+
+    /* Account for the time step that was just simulated and publish a sample every interval */
+    void update(const std::vector<Pyramidal_Neuron>& PY,
+                const std::vector<Inhibitory_Neuron>& IN,
+                const std::vector<Thalamocortical_Neuron>& TC,
+                const std::vector<Reticular_Neuron>& RE) {
+        if (!header) {
+            return;
+        }
+        counts[PYRAMIDAL]		= PY.size()*Lanes;
+        counts[INHIBITORY]		= IN.size()*Lanes;
+        counts[THALAMOCORTICAL]	= TC.size()*Lanes;
+        counts[RETICULAR]		= RE.size()*Lanes;
+        if (++step - sampled == header->interval) {
+            publish();
+        }
+    }
+
+    /* Publish the last partial interval, mark the run as finished and remove the name. Viewers
+     * keep their mapping
+     */
+    void close(void) {
+        if (!header) {
+            return;
+        }
+        if (step > sampled) {
+            publish();
+        }
+        header->finished.store(1, std::memory_order_release);
+#ifdef MONITOR_SHM
+        munmap(data, bytes);
+        shm_unlink(shared.c_str());
+#endif
+        header	= nullptr;
+        data	= nullptr;
+    }
+
+private:
+    monitorSample* slots(void) {return reinterpret_cast<monitorSample*>(data + sizeof(monitorHeader));}
+
+    static const lane& voltage_of(const Pyramidal_Neuron& neuron)		{return neuron.Vs[0];}
+    static const lane& voltage_of(const Inhibitory_Neuron& neuron)		{return neuron.V [0];}
+    static const lane& voltage_of(const Thalamocortical_Neuron& neuron)	{return neuron.V [0];}
+    static const lane& voltage_of(const Reticular_Neuron& neuron)		{return neuron.V [0];}
+
+    /* Write the sample of the steps since the last one into its slot. The sequence number marks
+     * the slot as being written first
+     */
+    void publish(void) {
+        const auto now = std::chrono::steady_clock::now();
+        const double seconds = std::chrono::duration<double>(now - last).count();
+        const uint64_t steps = step - sampled;
+        last	= now;
+        sampled	= step;
+
+        const uint64_t index = header->written.load(std::memory_order_relaxed);
+        monitorSample& sample = slots()[index % header->capacity];
+        sample.sequence.store(2*index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        sample.step			= step;
+        sample.time			= step*header->dt;
+        sample.span			= steps*header->dt;
+        sample.throughput	= seconds > 0.0 ? steps*header->dt/seconds : 0.0;
+        for (int type=0; type < 4; ++type) {
+            sample.voltage[type] = counts[type] ? voltage[type]/((double)counts[type]*steps) : 0.0;
+            sample.spikes [type] = spikes[type];
+            sample.neurons[type] = counts[type];
+            voltage[type] = 0.0;
+            spikes [type] = 0;
+        }
+        sample.sequence.store(2*index + 2, std::memory_order_release);
+        header->written.store(index + 1, std::memory_order_release);
+    }
+
+    /* Shared memory of the ring buffer */
+    char*			data	= nullptr;
+    size_t			bytes	= 0;
+    std::string		shared;
+    monitorHeader*	header	= nullptr;
+
+    /* Accumulated values since the last sample */
+    uint64_t		step	= 0;
+    uint64_t		sampled	= 0;	/* Time step of the last sample	*/
+    std::chrono::steady_clock::time_point last;
+    double			voltage[4] = {};
+    uint64_t		spikes [4] = {};
+    uint64_t		counts [4] = {};
+};
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
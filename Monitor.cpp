@@ -0,0 +1,91 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+/****************************************************************************************************/
+/*		Viewer of a running simulation																*/
+/*																									*/
+/*		Compile as the main file, e.g.																*/
+/*		g++ -std=c++11 -O2 Monitor.cpp -o Monitor -lrt												*/
+/*																									*/
+/*		Monitor /bazhenov [--every 10]																*/
+/*																									*/
+/*		Attaches to the monitor a run publishes under MonitorName and prints every n-th sample,		*/
+/*		the time, the simulated ms per wall second, and the firing rate in Hz and mean voltage in	*/
+/*		mV of every population. Ends with the run. The run never waits for the viewer.				*/
+/****************************************************************************************************/
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "Monitor_Buffer.h"
+
+/****************************************************************************************************/
+/*										Main viewer routine											*/
+/****************************************************************************************************/
+int main(int argc, char** argv) {
+    if (argc != 2 && !(argc == 4 && std::string(argv[2]) == "--every")) {
+        std::cerr << "usage: " << argv[0] << " /name [--every 10]\n";
+        return 1;
+    }
+    const uint64_t every = argc == 4 ? std::max(1, std::stoi(argv[3])) : 1;
+
+    /* Wait for the run to create the monitor */
+    Monitor_Reader reader;
+    while (!reader.attach(argv[1])) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+    std::printf("%10s %10s %16s %16s %16s %16s\n", "time [ms]", "ms/s", "PY [Hz|mV]", "IN [Hz|mV]", "TC [Hz|mV]", "RE [Hz|mV]");
+    uint64_t next = 0;
+    monitorSample sample;
+    while (true) {
+        const uint64_t written = reader.written();
+        /* Skip what was overwritten before we got to it */
+        if (written > next + reader.capacity()) {
+            next = written - reader.capacity();
+        }
+        for (; next < written; ++next) {
+            if (next % every != 0 || !reader.read(next, sample)) {
+                continue;
+            }
+            std::printf("%10.1f %10.1f", sample.time, sample.throughput);
+            for (int type=0; type < 4; ++type) {
+                /* Spikes since the last sample per neuron and second */
+                const double rate = sample.neurons[type] ? 1E3*sample.spikes[type]/(sample.neurons[type]*sample.span) : 0.0;
+                std::printf(" %7.2f|%7.2f", rate, sample.voltage[type]);
+            }
+            std::printf("\n");
+        }
+        std::fflush(stdout);
+        if (reader.finished() && next == reader.written()) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
+/****************************************************************************************************/
+/*										 		end			 										*/
+/****************************************************************************************************/
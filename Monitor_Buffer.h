@@ -0,0 +1,157 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+/****************************************************************************************************/
+/*							Shared ring buffer of the live monitor									*/
+/****************************************************************************************************/
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MONITOR_SHM
+#endif
+
+/* NOTE The monitor publishes a sample of the owned neurons every few time steps into a ring buffer
+ * in POSIX shared memory, that viewers map read-only
+ *
+ *		monitorHeader
+ *		monitorSample [capacity]		sample k in slot k % capacity
+ *
+ * A sample holds the mean voltage and the number of spikes of every population since the last
+ * sample, and the simulated ms per wall second. The run is the only writer and never waits for a
+ * viewer. Every slot carries a sequence number, that is odd while the slot is written and 2k + 2
+ * once sample k is complete, so a viewer copies a slot and keeps it if the sequence number was the
+ * expected one before and after the copy. Viewers that fall behind by more than the capacity lose
+ * the overwritten samples. The last sample of a run may cover less than the interval.
+ */
+struct monitorSample {
+    std::atomic<uint64_t>	sequence;
+    uint64_t				step;			/* Time step of the sample						*/
+    double					time;			/* Simulated time in ms							*/
+    double					span;			/* Simulated ms since the last sample			*/
+    double					throughput;		/* Simulated ms per wall second					*/
+    double					voltage[4];		/* Mean voltage of the populations in mV			*/
+    uint64_t				spikes [4];		/* Spikes of the populations since the last sample	*/
+    uint64_t				neurons[4];		/* Owned neurons of the populations				*/
+};
+
+struct monitorHeader {
+    char					magic[8];
+    uint32_t				version;
+    uint32_t				capacity;		/* Number of slots								*/
+    uint32_t				interval;		/* Time steps between two samples				*/
+    std::atomic<uint32_t>	finished;		/* Set once the last sample has been published	*/
+    double					dt;
+    std::atomic<uint64_t>	written;		/* Number of published samples					*/
+};
+
+/* Identification of the shared memory object */
+static const char	  MonitorMagic[8] = {'B', 'Z', 'M', 'O', 'N', 'I', 'T', 'R'};
+static const uint32_t MonitorVersion  = 2;
+
+/* Read-only view of the monitor of a run */
+class Monitor_Reader {
+public:
+    Monitor_Reader() = default;
+    Monitor_Reader(const Monitor_Reader&) = delete;
+    Monitor_Reader& operator=(const Monitor_Reader&) = delete;
+    ~Monitor_Reader() {
+#ifdef MONITOR_SHM
+        if (data) {
+            munmap(data, bytes);
+        }
+#endif
+    }
+
+    /* Map the monitor of the given name. Returns false if no run publishes it */
+    bool attach(const std::string& name) {
+#ifdef MONITOR_SHM
+        const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(monitorHeader)) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            return false;
+        }
+        void* region = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (region == MAP_FAILED) {
+            return false;
+        }
+        data	= static_cast<char*>(region);
+        bytes	= info.st_size;
+        header	= reinterpret_cast<const monitorHeader*>(data);
+        if (std::memcmp(header->magic, MonitorMagic, sizeof(header->magic)) != 0
+            || header->version != MonitorVersion
+            || bytes < sizeof(monitorHeader) + header->capacity*sizeof(monitorSample)) {
+            munmap(data, bytes);
+            data	= nullptr;
+            header	= nullptr;
+            return false;
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    uint64_t written	(void) const {return header->written.load(std::memory_order_acquire);}
+    bool	 finished	(void) const {return header->finished.load(std::memory_order_acquire) != 0;}
+    uint32_t capacity	(void) const {return header->capacity;}
+
+    /* Copy sample k. Returns false if it has been overwritten or is being written */
+    bool read(uint64_t k, monitorSample& copy) const {
+        const monitorSample& sample = reinterpret_cast<const monitorSample*>(data + sizeof(monitorHeader))[k % header->capacity];
+        const uint64_t before = sample.sequence.load(std::memory_order_acquire);
+        if (before != 2*k + 2) {
+            return false;
+        }
+        copy.step		= sample.step;
+        copy.time		= sample.time;
+        copy.span		= sample.span;
+        copy.throughput	= sample.throughput;
+        for (int type=0; type < 4; ++type) {
+            copy.voltage[type] = sample.voltage[type];
+            copy.spikes [type] = sample.spikes [type];
+            copy.neurons[type] = sample.neurons[type];
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return sample.sequence.load(std::memory_order_relaxed) == before;
+    }
+
+private:
+    char*					data	= nullptr;
+    size_t					bytes	= 0;
+    const monitorHeader*	header	= nullptr;
+};
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
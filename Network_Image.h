@@ -0,0 +1,477 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+/****************************************************************************************************/
+/*							Persistent binary image of a generated network							*/
+/****************************************************************************************************/
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define NETWORK_IMAGE_MMAP
+#endif
+
+/* NOTE The image is a single contiguous block, so that it can be written with one call and mapped
+ * read-only into memory by any number of processes. All offsets are given in bytes relative to the
+ * start of the image and are 8 byte aligned. The layout is
+ *
+ *		imageHeader
+ *		populationEntry	[numPopulations]
+ *		projectionEntry	[numProjections]
+ *		per population:	parameters	double	 [numCells x numParameters]	(row major)
+ *						identities	int32_t  [numCells]					(original neuron ids)
+ *		per projection:	rows		uint64_t [numCells[post] + 1]		(CSR row offsets)
+ *						indices		int32_t  [numSynapses]				(presynaptic neurons)
+ *
+ * Row j of a projection holds the indices of all presynaptic neurons that target neuron j. If the
+ * neurons have been renumbered for locality, the identities give the generated id of every neuron.
+ * The partial image of a rank only holds the rows of the neurons it owns and is never written.
+ */
+struct imageHeader {
+    char		magic[8];
+    uint32_t	version;
+    uint32_t	numPopulations;
+    uint32_t	numProjections;
+    uint32_t	flags;
+    uint64_t	seed;
+    uint64_t	configHash;
+    uint64_t	imageSize;
+};
+
+/* Flags of the image */
+enum imageFlags {
+    IMAGE_PARTIAL = 1	/* Only the rows of the neurons owned by a rank	*/
+};
+
+struct populationEntry {
+    uint32_t	numCells;
+    uint32_t	numParameters;
+    uint64_t	parameterOffset;
+    uint64_t	identityOffset;
+};
+
+struct projectionEntry {
+    uint32_t	post;
+    uint32_t	pre;
+    uint64_t	numSynapses;
+    uint64_t	rowOffset;
+    uint64_t	indexOffset;
+};
+
+/* Description of a projection prior to the allocation of the image */
+struct projectionLayout {
+    int			post;
+    int			pre;
+    uint64_t	numSynapses;
+};
+
+/* Range of presynaptic indices of a single neuron */
+struct index_range {
+    const int32_t* first;
+    const int32_t* last;
+    const int32_t* begin() const {return first;}
+    const int32_t* end  () const {return last;}
+    uint64_t	   size () const {return last - first;}
+};
+
+/******************************************************************************/
+/*                              FNV-1a hash                                   */
+/******************************************************************************/
+inline uint64_t hash_bytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
+
+/******************************************************************************/
+/*                          Class for the network image                       */
+/******************************************************************************/
+class Network_Image {
+public:
+    static const uint32_t Version = 2;
+
+    Network_Image() = default;
+    Network_Image(const Network_Image&) = delete;
+    Network_Image& operator=(const Network_Image&) = delete;
+    Network_Image(Network_Image&& other) {swap(other);}
+    Network_Image& operator=(Network_Image&& other) {swap(other); return *this;}
+    ~Network_Image() {release();}
+
+    /* Lay out an image in memory. Parameters and connectivity are filled in afterwards */
+    void allocate(uint64_t seed, uint64_t configHash,
+                  const std::vector<int>& numCells,
+                  const std::vector<int>& numParameters,
+                  const std::vector<projectionLayout>& projections) {
+        release();
+        uint64_t offset = align(sizeof(imageHeader)
+                                + numCells.size()   *sizeof(populationEntry)
+                                + projections.size()*sizeof(projectionEntry));
+        std::vector<populationEntry> populations(numCells.size());
+        for (unsigned i=0; i < numCells.size(); ++i) {
+            populations[i].numCells			= numCells[i];
+            populations[i].numParameters	= numParameters[i];
+            populations[i].parameterOffset	= offset;
+            offset += align(sizeof(double)*numCells[i]*numParameters[i]);
+            populations[i].identityOffset	= offset;
+            offset += align(sizeof(int32_t)*numCells[i]);
+        }
+        std::vector<projectionEntry> connections(projections.size());
+        for (unsigned i=0; i < projections.size(); ++i) {
+            const projectionLayout& proj = projections[i];
+            connections[i].post			= proj.post;
+            connections[i].pre			= proj.pre;
+            connections[i].numSynapses	= proj.numSynapses;
+            connections[i].rowOffset	= offset;
+            offset += align(sizeof(uint64_t)*(numCells[proj.post] + 1));
+            connections[i].indexOffset	= offset;
+            offset += align(sizeof(int32_t)*proj.numSynapses);
+        }
+
+        storage.assign(offset/sizeof(uint64_t), 0);
+        data = reinterpret_cast<char*>(storage.data());
+        size = offset;
+
+        imageHeader& head = *reinterpret_cast<imageHeader*>(data);
+        std::memcpy(head.magic, magic(), sizeof(head.magic));
+        head.version		= Version;
+        head.numPopulations	= populations.size();
+        head.numProjections	= connections.size();
+        head.seed			= seed;
+        head.configHash		= configHash;
+        head.imageSize		= size;
+        std::memcpy(data + sizeof(imageHeader), populations.data(),
+                    populations.size()*sizeof(populationEntry));
+        std::memcpy(data + sizeof(imageHeader) + populations.size()*sizeof(populationEntry),
+                    connections.data(), connections.size()*sizeof(projectionEntry));
+
+        /* Neurons start out in the order in which they were generated */
+        for (int pop=0; pop < numPopulations(); ++pop) {
+            int32_t* ids = identities(pop);
+            for (int i=0; i < numCells[pop]; ++i) {
+                ids[i] = i;
+            }
+        }
+    }
+
+    /* Copy of the image that only holds the CSR rows of the neurons [first[post], last[post]) of
+     * every projection, the other rows are empty. Parameters and identities are kept for all neurons
+     */
+    Network_Image slice(const std::vector<int>& first, const std::vector<int>& last) const {
+        std::vector<int> cells(numPopulations()), params(numPopulations());
+        for (int pop=0; pop < numPopulations(); ++pop) {
+            cells [pop] = numCells(pop);
+            params[pop] = numParameters(pop);
+        }
+        std::vector<projectionLayout> layout;
+        for (int proj=0; proj < numProjections(); ++proj) {
+            const uint64_t* row = rows(proj);
+            layout.push_back({post(proj), pre(proj), row[last[post(proj)]] - row[first[post(proj)]]});
+        }
+
+        Network_Image part;
+        part.allocate(seed(), configHash(), cells, params, layout);
+        part.markPartial();
+        for (int pop=0; pop < numPopulations(); ++pop) {
+            std::copy(parameters(pop, 0), parameters(pop, 0) + (uint64_t)cells[pop]*params[pop],
+                      part.parameters(pop, 0));
+            std::copy(identities(pop), identities(pop) + cells[pop], part.identities(pop));
+        }
+        for (int proj=0; proj < numProjections(); ++proj) {
+            const int begin = first[post(proj)], end = last[post(proj)];
+            const uint64_t* row = rows(proj);
+            uint64_t* partRow = part.rows(proj);
+            for (int j=0; j <= cells[post(proj)]; ++j) {
+                partRow[j] = row[std::min(std::max(j, begin), end)] - row[begin];
+            }
+            std::copy(indices(proj) + row[begin], indices(proj) + row[end], part.indices(proj));
+        }
+        return part;
+    }
+
+    /* Mark an image that only holds the rows of the neurons owned by a rank */
+    void markPartial(void) {
+        head().flags |= IMAGE_PARTIAL;
+    }
+
+    /* Write the image to disk. The file is renamed into place so that concurrent readers never
+     * observe a partially written image
+     */
+    void save(const std::string& file) const {
+        if (!data) {
+            throw std::runtime_error("Cannot save an empty network image!");
+        }
+        if (partial()) {
+            throw std::runtime_error("Cannot save the partial network image of a rank!");
+        }
+        const std::string temporary = temporaryFile(file);
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(data, size);
+        out.close();
+        if (!out || std::rename(temporary.c_str(), file.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            throw std::runtime_error("Could not write network image " + file);
+        }
+    }
+
+    /* Map an image from disk. Returns false if the file does not exist or is not a valid image */
+    bool load(const std::string& file) {
+        release();
+#ifdef NETWORK_IMAGE_MMAP
+        int fd = open(file.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(imageHeader)) {
+            close(fd);
+            return false;
+        }
+        void* map = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+            return false;
+        }
+        data	= static_cast<char*>(map);
+        size	= info.st_size;
+        mapped	= true;
+#else
+        std::ifstream in(file, std::ios::binary | std::ios::ate);
+        if (!in) {
+            return false;
+        }
+        size = in.tellg();
+        storage.resize((size + sizeof(uint64_t) - 1)/sizeof(uint64_t));
+        data = reinterpret_cast<char*>(storage.data());
+        in.seekg(0);
+        in.read(data, size);
+#endif
+        if (!valid()) {
+            release();
+            return false;
+        }
+        return true;
+    }
+
+    /* Access to the header information */
+    bool		empty			(void)		const {return data == nullptr;}
+    uint64_t	seed			(void)		const {return header().seed;}
+    uint64_t	configHash		(void)		const {return header().configHash;}
+    uint64_t	bytes			(void)		const {return size;}
+    bool		partial			(void)		const {return header().flags & IMAGE_PARTIAL;}
+    int			numPopulations	(void)		const {return header().numPopulations;}
+    int			numProjections	(void)		const {return header().numProjections;}
+    int			numCells		(int pop)	const {return population(pop).numCells;}
+    int			numParameters	(int pop)	const {return population(pop).numParameters;}
+    int			post			(int proj)	const {return projection(proj).post;}
+    int			pre				(int proj)	const {return projection(proj).pre;}
+    uint64_t	numSynapses		(int proj)	const {return projection(proj).numSynapses;}
+
+    /* Index of the projection from population pre onto population post */
+    int findProjection(int post, int pre) const {
+        for (int i=0; i < numProjections(); ++i) {
+            if (projection(i).post == (uint32_t)post && projection(i).pre == (uint32_t)pre) {
+                return i;
+            }
+        }
+        throw std::runtime_error("Network image does not contain the requested projection!");
+    }
+
+    /* Parameters of a single neuron */
+    const double* parameters(int pop, int neuron) const {
+        return at<double>(population(pop).parameterOffset) + neuron*numParameters(pop);
+    }
+    double* parameters(int pop, int neuron) {
+        return writable<double>(population(pop).parameterOffset) + neuron*numParameters(pop);
+    }
+
+    /* Generated id of every neuron of a population */
+    const int32_t*	identities(int pop) const {return at<int32_t>(population(pop).identityOffset);}
+    int32_t*		identities(int pop)		  {return writable<int32_t>(population(pop).identityOffset);}
+
+    /* True if the neurons of any population have been renumbered */
+    bool renumbered(void) const {
+        for (int pop=0; pop < numPopulations(); ++pop) {
+            const int32_t* ids = identities(pop);
+            for (int i=0; i < numCells(pop); ++i) {
+                if (ids[i] != i) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /* CSR arrays of a projection */
+    const uint64_t* rows   (int proj) const {return at<uint64_t>(projection(proj).rowOffset);}
+    const int32_t*	indices(int proj) const {return at<int32_t> (projection(proj).indexOffset);}
+    uint64_t*		rows   (int proj)		{return writable<uint64_t>(projection(proj).rowOffset);}
+    int32_t*		indices(int proj)		{return writable<int32_t> (projection(proj).indexOffset);}
+
+    /* Presynaptic neurons of neuron "neuron" in projection proj */
+    index_range inputs(int proj, int neuron) const {
+        const uint64_t* row = rows(proj);
+        return {indices(proj) + row[neuron], indices(proj) + row[neuron+1]};
+    }
+
+    /* Largest number of synapses between the same two neurons of a projection */
+    int maxMultiplicity(int proj) const {
+        int maximum = 0;
+        for (int j=0; j < numCells(post(proj)); ++j) {
+            const index_range row = inputs(proj, j);
+            int count = 0;
+            for (const int32_t* i=row.begin(); i < row.end(); ++i) {
+                count = (i != row.begin() && *i == *(i-1)) ? count + 1 : 1;
+                maximum = std::max(maximum, count);
+            }
+        }
+        return maximum;
+    }
+
+    /* Unique name of a temporary file next to a file of cached data. The process id, the calling
+     * thread and a counter of the process tell apart concurrent writers of the same file
+     */
+    static std::string temporaryFile(const std::string& file) {
+        static std::atomic<unsigned> counter(0);
+#ifdef NETWORK_IMAGE_MMAP
+        const long process = getpid();
+#else
+        const long process = 0;
+#endif
+        const size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+        char suffix[64];
+        snprintf(suffix, sizeof(suffix), ".%ld.%zx.%u.tmp", process, thread, counter++);
+        return file + suffix;
+    }
+
+private:
+    static const char* magic(void) {return "BZNETIMG";}
+
+    static uint64_t align(uint64_t bytes) {
+        return (bytes + 7) & ~uint64_t(7);
+    }
+
+    const imageHeader& header(void) const {
+        return *reinterpret_cast<const imageHeader*>(data);
+    }
+    imageHeader& head(void) {
+        return *writable<imageHeader>(0);
+    }
+    const populationEntry& population(int pop) const {
+        return reinterpret_cast<const populationEntry*>(data + sizeof(imageHeader))[pop];
+    }
+    const projectionEntry& projection(int proj) const {
+        return reinterpret_cast<const projectionEntry*>(data + sizeof(imageHeader)
+                + numPopulations()*sizeof(populationEntry))[proj];
+    }
+
+    template<typename T>
+    const T* at(uint64_t offset) const {
+        return reinterpret_cast<const T*>(data + offset);
+    }
+    template<typename T>
+    T* writable(uint64_t offset) {
+        if (mapped) {
+            throw std::runtime_error("Mapped network images are read-only!");
+        }
+        return reinterpret_cast<T*>(data + offset);
+    }
+
+    /* Check that the image is complete and every section lies within the file */
+    bool valid(void) const {
+        if (size < sizeof(imageHeader)
+            || std::memcmp(header().magic, magic(), sizeof(header().magic)) != 0
+            || header().version   != Version
+            || header().imageSize != size) {
+            return false;
+        }
+        uint64_t tables = sizeof(imageHeader) + numPopulations()*sizeof(populationEntry)
+                                              + numProjections()*sizeof(projectionEntry);
+        if (tables > size) {
+            return false;
+        }
+        for (int i=0; i < numPopulations(); ++i) {
+            if (population(i).parameterOffset
+                + sizeof(double)*numCells(i)*numParameters(i) > size
+                || population(i).identityOffset + sizeof(int32_t)*numCells(i) > size) {
+                return false;
+            }
+        }
+        for (int i=0; i < numProjections(); ++i) {
+            const projectionEntry& proj = projection(i);
+            if ((int)proj.post >= numPopulations() || (int)proj.pre >= numPopulations()
+                || proj.rowOffset   + sizeof(uint64_t)*(numCells(proj.post) + 1) > size
+                || proj.indexOffset + sizeof(int32_t) *proj.numSynapses			 > size
+                || rows(i)[numCells(proj.post)] != proj.numSynapses) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void release(void) {
+#ifdef NETWORK_IMAGE_MMAP
+        if (mapped) {
+            munmap(data, size);
+        }
+#endif
+        storage.clear();
+        data	= nullptr;
+        size	= 0;
+        mapped	= false;
+    }
+
+    void swap(Network_Image& other) {
+        std::swap(storage, other.storage);
+        std::swap(data,    other.data);
+        std::swap(size,    other.size);
+        std::swap(mapped,  other.mapped);
+    }
+
+    /* Image either owned in memory or mapped from disk */
+    std::vector<uint64_t>	storage;
+    char*					data	= nullptr;
+    uint64_t				size	= 0;
+    bool					mapped	= false;
+};
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
@@ -0,0 +1,105 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+
+/****************************************************************************************************/
+/*							Outgoing synapses of a projection										*/
+/****************************************************************************************************/
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "Network_Image.h"
+
+/* NOTE The network image stores the synapses by their postsynaptic neuron. To push the change of a
+ * presynaptic neuron to its targets, the rows of the owned postsynaptic neurons [first, last) are
+ * transposed. The targets of every presynaptic neuron are local indices j - first in ascending
+ * order, so a thread that owns a block of neurons finds its targets by bisection.
+ */
+
+/* Change of the synaptic variables of a presynaptic neuron since they were last pushed */
+struct synapticChange {
+    int		neuron;
+    double	delta_A;
+    double	delta_B;
+};
+
+class Outgoing_Synapses {
+public:
+    Outgoing_Synapses() = default;
+
+    Outgoing_Synapses(const Network_Image& image, int proj, int first, int last) {
+        const int numPre = image.numCells(image.pre(proj));
+        rows.assign(numPre + 1, 0);
+        for (int j=first; j < last; ++j) {
+            for (int i : image.inputs(proj, j)) {
+                rows[i+1]++;
+            }
+        }
+        for (int i=0; i < numPre; ++i) {
+            rows[i+1] += rows[i];
+        }
+
+        targets.resize(rows[numPre]);
+        std::vector<uint64_t> fill(rows.begin(), rows.end() - 1);
+        for (int j=first; j < last; ++j) {
+            for (int i : image.inputs(proj, j)) {
+                targets[fill[i]++] = j - first;
+            }
+        }
+    }
+
+    /* Whether presynaptic neuron i has any owned target */
+    bool connected(int i) const {return rows[i+1] > rows[i];}
+
+    uint64_t bytes(void) const {return rows.size()*sizeof(uint64_t) + targets.size()*sizeof(int32_t);}
+
+    /* Add the changes to the inputs of the local neurons [begin, end) for up to two synaptic
+     * variables
+     */
+    void push(const std::vector<synapticChange>& changes, int begin, int end,
+              double* in_A, double* in_B) const {
+        for (const synapticChange& change : changes) {
+            const int32_t* last	= targets.data() + rows[change.neuron+1];
+            const int32_t* j	= std::lower_bound(targets.data() + rows[change.neuron], last, begin);
+            if (in_B) {
+                for (; j < last && *j < end; ++j) {
+                    in_A[*j] += change.delta_A;
+                    in_B[*j] += change.delta_B;
+                }
+            } else {
+                for (; j < last && *j < end; ++j) {
+                    in_A[*j] += change.delta_A;
+                }
+            }
+        }
+    }
+
+private:
+    std::vector<uint64_t>	rows;		/* Offsets of the targets per presynaptic neuron	*/
+    std::vector<int32_t>	targets;	/* Local postsynaptic neurons, ascending per row	*/
+};
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
@@ -0,0 +1,309 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+
+/****************************************************************************************************/
+/*									Sweep over the run settings										*/
+/****************************************************************************************************/
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "Data_Storage.h"
+#include "Initialize_Neurons.h"
+#include "Iterate_ODE.h"
+
+/* NOTE A sweep runs whole simulations for a list of run settings within a single process. A run
+ * gets one thread per MinCellsPerThread neurons, as the barriers of a parallel region cost more
+ * than the work of a few hundred neurons per thread, and N_Cores/threads runs share the cores. The
+ * runs are the tasks of a work-stealing pool, in which every worker takes the next point of its
+ * own block and steals from the end of the others once it is done. The parallel regions of a run
+ * are nested within its worker and use the share of threads set by runThreadShare.
+ *
+ * With a cache directory the network of every seed and set of connection widths is generated once
+ * before the runs start, so the runs only map the shared image. The profiler is not meant for
+ * concurrent runs.
+ */
+struct sweepSummary {
+    int		threads	= 0;		/* Threads of the run							*/
+    double	seconds	= 0.0;		/* Duration of the simulation					*/
+    double	rate_PY	= 0.0;		/* Mean firing rate of the pyramidal cells in Hz	*/
+    double	rate_IN	= 0.0;		/* Mean firing rate of the inhibitory cells in Hz	*/
+    double	V_PY	= 0.0;		/* Mean somatic voltage of the pyramidal cells	*/
+    double	V_IN	= 0.0;		/* Mean voltage of the inhibitory cells			*/
+    double	Ca_PY	= 0.0;		/* Mean dendritic calcium of the pyramidal cells	*/
+};
+
+class Parameter_Sweep {
+public:
+    explicit Parameter_Sweep(std::vector<runSettings> settings) : points(std::move(settings)) {}
+
+    /* All combinations of the given seeds, drives, noise amplitudes, conductances and connection
+     * widths
+     */
+    static std::vector<runSettings> grid(const std::vector<unsigned>& seeds,
+                                         const std::vector<std::vector<driveSettings>>& drives,
+                                         const std::vector<std::vector<double>>& noises,
+                                         const std::vector<populationParameters>& parameters,
+                                         const std::vector<std::vector<double>>& widths) {
+        std::vector<runSettings> settings;
+        for (unsigned seed : seeds) {
+            for (const auto &drive : drives) {
+                for (const auto &noise : noises) {
+                    for (const auto &channels : parameters) {
+                        for (const auto &width : widths) {
+                            settings.push_back({seed, drive, noise, fixedSettings().stimulus, width, channels});
+                        }
+                    }
+                }
+            }
+        }
+        return settings;
+    }
+
+    /* Threads of every run, one per MinCellsPerThread neurons but at most N_Cores */
+    int threadsPerRun(void) const {
+        extern const int N_Cores;
+        extern const std::vector<int> NumCells;
+        extern const int Trials;
+        long long cells = 0;
+        for (int n : NumCells) {
+            cells += n;
+        }
+        return (int)std::max(1LL, std::min<long long>(N_Cores, cells*Trials/MinCellsPerThread));
+    }
+
+    /* Simulate every point for numSteps time steps and write its summary into directory */
+    void run(int numSteps, const std::string& directory) {
+        extern const int N_Cores;
+        prepareNetworks();
+        const int threads = threadsPerRun();
+        const int workers = std::max(1, std::min<int>(N_Cores/threads, points.size()));
+        summaries.assign(points.size(), sweepSummary());
+
+        /* Every worker starts with a contiguous block of the points */
+        std::vector<std::unique_ptr<workQueue>> queues;
+        for (int w=0; w < workers; ++w) {
+            queues.emplace_back(new workQueue());
+            for (unsigned p=points.size()*w/workers; p < points.size()*(w + 1)/workers; ++p) {
+                queues.back()->points.push_back(p);
+            }
+        }
+
+#ifdef _OPENMP
+        /* The regions of a run are nested within the team of workers, and only active if a run
+         * has more than one thread
+         */
+        const int levels = omp_get_max_active_levels();
+        omp_set_max_active_levels(threads > 1 ? 2 : 1);
+#endif
+        std::vector<std::string> errors(workers);
+        #pragma omp parallel num_threads(workers)
+        {
+            const int worker = threadNum();
+            int point;
+            runThreadShare() = threads;
+            try {
+                while (next(queues, worker, point)) {
+                    summaries[point] = simulate(points[point], numSteps, threads);
+                    write(directory, point, summaries[point]);
+                }
+            } catch (const std::exception& error) {
+                errors[worker] = error.what();
+            }
+            runThreadShare() = 0;
+        }
+#ifdef _OPENMP
+        omp_set_max_active_levels(levels);
+#endif
+        for (const std::string& error : errors) {
+            if (!error.empty()) {
+                throw std::runtime_error(error);
+            }
+        }
+    }
+
+    const std::vector<runSettings>&  settings(void)	const {return points;}
+    const std::vector<sweepSummary>& results (void)	const {return summaries;}
+
+private:
+    /* Smallest number of neurons per thread for which a run is split across threads */
+    static const int MinCellsPerThread = 2048;
+
+    /* Points that are left for a worker */
+    struct workQueue {
+        std::mutex		lock;
+        std::deque<int>	points;
+    };
+
+    /* Take the next point of the own queue or steal the last one of another worker */
+    static bool next(std::vector<std::unique_ptr<workQueue>>& queues, int worker, int& point) {
+        for (unsigned k=0; k < queues.size(); ++k) {
+            workQueue& queue = *queues[(worker + k) % queues.size()];
+            std::lock_guard<std::mutex> guard(queue.lock);
+            if (!queue.points.empty()) {
+                if (k == 0) {
+                    point = queue.points.front();
+                    queue.points.pop_front();
+                } else {
+                    point = queue.points.back();
+                    queue.points.pop_back();
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* Generate the network of every seed and set of widths once, so that concurrent runs only map
+     * the cached image
+     */
+    void prepareNetworks(void) const {
+        extern const std::string NetworkCache;
+        if (NetworkCache.empty()) {
+            return;
+        }
+        std::set<std::pair<unsigned, std::vector<double>>> networks;
+        for (const runSettings& point : points) {
+            networks.insert(std::make_pair(point.seed, point.width));
+        }
+        for (const auto &network : networks) {
+            getNetwork(network.first, network.second);
+        }
+    }
+
+    /* Simulate a point and summarize the recorded variables */
+    static sweepSummary simulate(const runSettings& settings, int numSteps, int threads) {
+        extern const double dt;
+        std::vector<Pyramidal_Neuron> PY;
+        std::vector<Inhibitory_Neuron> IN;
+        std::vector<Thalamocortical_Neuron> TC;
+        std::vector<Reticular_Neuron> RE;
+        Synaptic_Input synapses;
+        setupNetwork(PY, IN, TC, RE, synapses, settings);
+
+        /* Only the current time step of every lane is recorded */
+        std::vector<double> V_PY(PY.size()*Lanes), V_IN(IN.size()*Lanes), Ca_PY(PY.size()*Lanes);
+        std::vector<double*> pData = {V_PY.data(), V_IN.data(), Ca_PY.data()};
+        get_data(0, PY, IN, TC, RE, pData);
+        std::vector<double> last_PY = V_PY, last_IN = V_IN;
+
+        sweepSummary summary;
+        long long spikes_PY = 0, spikes_IN = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (int t=0; t < numSteps; ++t) {
+            Iterate_ODE(PY, IN, TC, RE, synapses);
+            get_data(0, PY, IN, TC, RE, pData);
+            spikes_PY += accumulate(V_PY, last_PY, summary.V_PY);
+            spikes_IN += accumulate(V_IN, last_IN, summary.V_IN);
+            for (double Ca : Ca_PY) {
+                summary.Ca_PY += Ca;
+            }
+        }
+        summary.seconds	= std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        summary.threads	= threads;
+
+        const double duration = 1E-3*numSteps*dt;
+        summary.rate_PY	 = spikes_PY/(duration*std::max<size_t>(V_PY.size(), 1));
+        summary.rate_IN	 = spikes_IN/(duration*std::max<size_t>(V_IN.size(), 1));
+        summary.V_PY	/= (double)numSteps*std::max<size_t>(V_PY.size(), 1);
+        summary.V_IN	/= (double)numSteps*std::max<size_t>(V_IN.size(), 1);
+        summary.Ca_PY	/= (double)numSteps*std::max<size_t>(Ca_PY.size(), 1);
+        return summary;
+    }
+
+    /* Add up the voltages of a time step and count the crossings of the spike threshold */
+    static long long accumulate(const std::vector<double>& V, std::vector<double>& last, double& sum) {
+        static const double Threshold = 0.0;
+        long long spikes = 0;
+        for (unsigned i=0; i < V.size(); ++i) {
+            spikes	+= last[i] < Threshold && V[i] >= Threshold;
+            sum		+= V[i];
+            last[i]	 = V[i];
+        }
+        return spikes;
+    }
+
+    /* Write the settings and the summary of a point as JSON */
+    void write(const std::string& directory, int point, const sweepSummary& summary) const {
+        static const char* Modes[3] = {"none", "poisson", "ou"};
+        const runSettings& settings = points[point];
+        std::ofstream out(directory + "/sweep_" + std::to_string(point) + ".json");
+        out << "{\"point\":" << point << ",\"seed\":" << settings.seed << ",\"drive\":[";
+        for (unsigned type=0; type < settings.drive.size(); ++type) {
+            const driveSettings& drive = settings.drive[type];
+            out << (type ? "," : "") << "{\"mode\":\"" << Modes[drive.mode] << "\",\"rate\":" << drive.rate
+                << ",\"weight\":" << drive.weight << ",\"mean\":" << drive.mean
+                << ",\"sigma\":" << drive.sigma << ",\"tau\":" << drive.tau << "}";
+        }
+        out << "],\"noise\":[";
+        for (unsigned type=0; type < settings.noise.size(); ++type) {
+            out << (type ? "," : "") << settings.noise[type];
+        }
+        out << "],\"width\":[";
+        for (unsigned type=0; type < settings.width.size(); ++type) {
+            out << (type ? "," : "") << settings.width[type];
+        }
+        out << "],\"parameters\":{";
+        const char* separator = "";
+        forEachParameter(settings.parameters, [&](const char* name, const double& value) {
+            out << separator << "\"" << name << "\":" << value;
+            separator = ",";
+        });
+        out << "},\"stimulus\":\"" << settings.stimulus << "\""
+            << ",\"threads\":" << summary.threads << ",\"seconds\":" << summary.seconds
+            << ",\"rate_PY\":" << summary.rate_PY << ",\"rate_IN\":" << summary.rate_IN
+            << ",\"V_PY\":" << summary.V_PY << ",\"V_IN\":" << summary.V_IN
+            << ",\"Ca_PY\":" << summary.Ca_PY << "}\n";
+        if (!out) {
+            throw std::runtime_error("Could not write the summary of point " + std::to_string(point) + "!");
+        }
+    }
+
+    static int threadNum(void) {
+#ifdef _OPENMP
+        return omp_get_thread_num();
+#else
+        return 0;
+#endif
+    }
+
+    std::vector<runSettings>	points;
+    std::vector<sweepSummary>	summaries;
+};
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
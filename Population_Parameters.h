@@ -0,0 +1,145 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+
+
+/****************************************************************************************************/
+/*							Conductances shared by the populations									*/
+/****************************************************************************************************/
+#pragma once
+#include <string>
+
+/* NOTE The channel conductivities of a population are the same for all of its neurons, but they are
+ * the usual dimensions of a parameter sweep. They are therefore set per run in runSettings. A run
+ * keeps a single copy in Synaptic_Input, which hands it to set_RK, so the neurons do not grow with it.
+ * The defaults are the values of Bazhenov2002. Only the channels of the voltage equations are listed,
+ * the thalamocortical cells of this model have no I_A and I_h, so their conductances are unknown names.
+ */
+struct pyramidalParameters {
+    double	g_Na	= 50.;
+    double	g_K		= 10.5;
+    double	g_A		= 1.;
+    double	g_KS	= 0.0686;
+    double	g_KNa	= 1.33;
+
+    double	g_Ca	= 0.43;
+    double	g_KCa	= 0.57;
+    double	g_NaP	= 68.6E-3;
+    double	g_AR	= 25.7E-3;
+
+    double	g_AMPA	= 5.4E-6;
+    double	g_NMDA	= 0.9E-6;
+    double	g_GABA	= 4.15E-6;
+};
+
+struct inhibitoryParameters {
+    double	g_Na	= 35;
+    double	g_K		= 9;
+
+    double	g_AMPA	= 2.25E-6;
+    double	g_NMDA	= 0.5E-6;
+    double	g_GABA	= 0.165E-6;
+};
+
+struct thalamocorticalParameters {
+    double	g_LK	= 102.5E-3;
+    double	g_Na	= 35;
+    double	g_K		= 9;
+    double	g_Ca	= 35;
+
+    double	g_AMPA	= 2.25E-6;
+    double	g_NMDA	= 0.5E-6;
+    double	g_GABA	= 0.165E-6;
+};
+
+struct reticularParameters {
+    double	g_LK	= 102.5E-3;
+    double	g_Na	= 35;
+    double	g_K		= 9;
+    double	g_Ca	= 35;
+
+    double	g_AMPA	= 2.25E-6;
+    double	g_NMDA	= 0.5E-6;
+    double	g_GABA	= 0.165E-6;
+};
+
+/* Conductances of all populations of a run */
+struct populationParameters {
+    pyramidalParameters			PY;
+    inhibitoryParameters		IN;
+    thalamocorticalParameters	TC;
+    reticularParameters			RE;
+};
+
+/* Call function(name, value) for every conductance, named "population.g_X" like "PY.g_KNa" */
+template<class PARAMETERS, typename FUNCTION>
+void forEachParameter(PARAMETERS& parameters, FUNCTION&& function) {
+    function("PY.g_Na",		parameters.PY.g_Na);
+    function("PY.g_K",		parameters.PY.g_K);
+    function("PY.g_A",		parameters.PY.g_A);
+    function("PY.g_KS",		parameters.PY.g_KS);
+    function("PY.g_KNa",	parameters.PY.g_KNa);
+    function("PY.g_Ca",		parameters.PY.g_Ca);
+    function("PY.g_KCa",	parameters.PY.g_KCa);
+    function("PY.g_NaP",	parameters.PY.g_NaP);
+    function("PY.g_AR",		parameters.PY.g_AR);
+    function("PY.g_AMPA",	parameters.PY.g_AMPA);
+    function("PY.g_NMDA",	parameters.PY.g_NMDA);
+    function("PY.g_GABA",	parameters.PY.g_GABA);
+
+    function("IN.g_Na",		parameters.IN.g_Na);
+    function("IN.g_K",		parameters.IN.g_K);
+    function("IN.g_AMPA",	parameters.IN.g_AMPA);
+    function("IN.g_NMDA",	parameters.IN.g_NMDA);
+    function("IN.g_GABA",	parameters.IN.g_GABA);
+
+    function("TC.g_LK",		parameters.TC.g_LK);
+    function("TC.g_Na",		parameters.TC.g_Na);
+    function("TC.g_K",		parameters.TC.g_K);
+    function("TC.g_Ca",		parameters.TC.g_Ca);
+    function("TC.g_AMPA",	parameters.TC.g_AMPA);
+    function("TC.g_NMDA",	parameters.TC.g_NMDA);
+    function("TC.g_GABA",	parameters.TC.g_GABA);
+
+    function("RE.g_LK",		parameters.RE.g_LK);
+    function("RE.g_Na",		parameters.RE.g_Na);
+    function("RE.g_K",		parameters.RE.g_K);
+    function("RE.g_Ca",		parameters.RE.g_Ca);
+    function("RE.g_AMPA",	parameters.RE.g_AMPA);
+    function("RE.g_NMDA",	parameters.RE.g_NMDA);
+    function("RE.g_GABA",	parameters.RE.g_GABA);
+}
+
+/* Conductance of the given name, or nullptr if there is none */
+inline double* findParameter(populationParameters& parameters, const std::string& name) {
+    double* found = nullptr;
+    forEachParameter(parameters, [&](const char* key, double& value) {
+        if (name == key) {
+            found = &value;
+        }
+    });
+    return found;
+}
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
@@ -0,0 +1,492 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+/****************************************************************************************************/
+/*							Timing of the phases of a time step										*/
+/****************************************************************************************************/
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(PROFILE_COUNTERS) && !defined(PROFILE_PHASES)
+#define PROFILE_PHASES
+#endif
+
+#if defined(PROFILE_COUNTERS) && defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define PROFILE_PERF_EVENTS
+#endif
+
+/* NOTE Compiling with PROFILE_PHASES records the begin and end of every phase per thread. Without
+ * it PROFILE_PHASE expands to nothing, so there is no overhead. A phase ends with the work of the
+ * thread, the time until the last thread of the team finished the same phase is the barrier wait.
+ * Every thread of a team has to record every instance of a phase, so that they can be matched.
+ * The events of a time step are folded into running statistics per phase by fold(), which is
+ * called outside of any parallel region, so the memory does not grow with the simulated time.
+ * The wall times of the instances are counted in a histogram with 16 buckets per octave, which
+ * gives the 99th percentile within 5%. With PROFILE_TRACE the first MaxTraceEvents events are kept
+ * for the trace file.
+ *
+ * With PROFILE_COUNTERS every thread additionally opens a group of hardware counters through
+ * perf_event_open, which is read at the begin and end of every phase. This fails, if the kernel
+ * does not allow unprivileged counters (kernel.perf_event_paranoid > 2), which is reported.
+ */
+enum profilePhase {
+    PUBLISH = 0,
+    EXCHANGE,
+    SUM,
+    DELIVER,
+    DRIVE_INPUT,
+    SET_RK_PY,
+    SET_RK_IN,
+    SET_RK_TC,
+    SET_RK_RE,
+    ADD_RK_PY,
+    ADD_RK_IN,
+    ADD_RK_TC,
+    ADD_RK_RE,
+    NUM_PHASES
+};
+
+enum profileCounter {
+    CYCLES = 0,
+    INSTRUCTIONS,
+    CACHE_MISSES,
+    BRANCH_MISSES,
+    NUM_COUNTERS
+};
+
+class Profiler {
+public:
+    Profiler() : epoch(std::chrono::steady_clock::now()) {
+        extern const int N_Cores;
+        logs.resize(std::max(N_Cores, threadCount()));
+    }
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    ~Profiler() {
+#ifdef PROFILE_PERF_EVENTS
+        for (threadLog& log : logs) {
+            closeCounters(log);
+        }
+#endif
+    }
+
+    static const char* name(int phase) {
+        static const char* names[NUM_PHASES] = {
+            "publish", "exchange", "sum", "deliver", "drive",
+            "set_RK PY", "set_RK IN", "set_RK TC", "set_RK RE",
+            "add_RK PY", "add_RK IN", "add_RK TC", "add_RK RE"};
+        return names[phase];
+    }
+
+    /* Nanoseconds since the creation of the profiler */
+    int64_t now(void) const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    void record(profilePhase phase, int64_t start, int64_t end) {
+        const unsigned thread = threadNum();
+        if (thread < logs.size()) {
+            logs[thread].events.push_back(event{start, end, phase});
+        }
+    }
+
+    /* Fold the recorded events into the statistics of the phases. The k-th instances of a phase of
+     * all threads form one instance of the team. Has to be called outside of any parallel region
+     */
+    void fold(void) {
+        std::vector<std::vector<event>> instances(logs.size());
+        for (int phase=0; phase < NUM_PHASES; ++phase) {
+            size_t count = 0;
+            for (unsigned t=0; t < logs.size(); ++t) {
+                instances[t].clear();
+                for (const event& e : logs[t].events) {
+                    if (e.phase == phase) {
+                        instances[t].push_back(e);
+                    }
+                }
+                count = std::max(count, instances[t].size());
+            }
+            phaseStatistics& stats = statistics[phase];
+            for (size_t k=0; k < count; ++k) {
+                int64_t first = INT64_MAX, last = INT64_MIN;
+                double sum = 0.0, max = 0.0;
+                int threads = 0;
+                for (const auto& events : instances) {
+                    if (k < events.size()) {
+                        first = std::min(first, events[k].start);
+                        last  = std::max(last,  events[k].end);
+                        const double duration = events[k].end - events[k].start;
+                        sum += duration;
+                        max  = std::max(max, duration);
+                        ++threads;
+                    }
+                }
+                for (const auto& events : instances) {
+                    if (k < events.size()) {
+                        stats.wait += last - events[k].end;
+                    }
+                }
+                stats.count++;
+                stats.samples	+= threads;
+                stats.span		+= last - first;
+                stats.work		+= sum;
+                stats.imbalance	+= sum > 0.0 ? max*threads/sum - 1.0 : 0.0;
+                stats.histogram[bucket(last - first)]++;
+            }
+        }
+
+        for (unsigned t=0; t < logs.size(); ++t) {
+#ifdef PROFILE_TRACE
+            for (const event& e : logs[t].events) {
+                if (trace.size() < MaxTraceEvents) {
+                    trace.push_back(tracedEvent{e, (int)t});
+                }
+            }
+#endif
+            logs[t].events.clear();
+        }
+    }
+
+    /* Current values of the hardware counters of the calling thread, zero if unavailable */
+    void readCounters(uint64_t* values) {
+        std::fill(values, values + NUM_COUNTERS, 0);
+#ifdef PROFILE_PERF_EVENTS
+        const unsigned thread = threadNum();
+        if (thread >= logs.size()) {
+            return;
+        }
+        threadLog& log = logs[thread];
+        if (!log.opened) {
+            openCounters(log);
+        }
+        if (log.fds[0] < 0) {
+            return;
+        }
+        /* PERF_FORMAT_GROUP returns the number of counters followed by their values */
+        uint64_t buffer[1 + NUM_COUNTERS];
+        if (read(log.fds[0], buffer, sizeof(buffer)) == (ssize_t)sizeof(buffer)) {
+            std::copy(buffer + 1, buffer + 1 + NUM_COUNTERS, values);
+        }
+#endif
+    }
+
+    void recordCounters(profilePhase phase, const uint64_t* start, const uint64_t* end) {
+        const unsigned thread = threadNum();
+        if (thread < logs.size()) {
+            for (int c=0; c < NUM_COUNTERS; ++c) {
+                logs[thread].counters[phase][c] += end[c] - start[c];
+            }
+        }
+    }
+
+    void clear(void) {
+        statistics = std::vector<phaseStatistics>(NUM_PHASES);
+        trace.clear();
+        for (threadLog& log : logs) {
+            log.events.clear();
+            for (auto& counters : log.counters) {
+                std::fill(counters, counters + NUM_COUNTERS, 0);
+            }
+        }
+    }
+
+    /* Summary per phase: mean and 99th percentile of the wall time of an instance, mean work and
+     * barrier wait per thread and the load imbalance max/mean - 1 of the work
+     */
+    void report(std::ostream& out) const {
+        out << std::left << std::setw(12) << "phase"
+            << std::right << std::setw(10) << "count"
+            << std::setw(12) << "mean[us]" << std::setw(12) << "p99[us]"
+            << std::setw(12) << "work[us]" << std::setw(12) << "wait[us]"
+            << std::setw(12) << "imbalance" << std::setw(10) << "share" << "\n";
+
+        double total = 0.0;
+        for (const phaseStatistics& stats : statistics) {
+            total += stats.span;
+        }
+        for (int phase=0; phase < NUM_PHASES; ++phase) {
+            const phaseStatistics& stats = statistics[phase];
+            if (stats.count == 0) {
+                continue;
+            }
+            out << std::left << std::setw(12) << name(phase) << std::right
+                << std::setw(10) << stats.count << std::fixed << std::setprecision(3)
+                << std::setw(12) << 1E-3*stats.span/stats.count
+                << std::setw(12) << 1E-3*percentile(stats, 0.99)
+                << std::setw(12) << 1E-3*stats.work/stats.samples
+                << std::setw(12) << 1E-3*stats.wait/stats.samples
+                << std::setw(12) << stats.imbalance/stats.count
+                << std::setw(9)  << 100.0*stats.span/total << "%\n";
+            out.unsetf(std::ios::fixed);
+        }
+    }
+
+    /* Hardware counters per neuron and time step of every population. The RK functions are
+     * attributed to their population, the gather is normalized by all neurons
+     */
+    void reportCounters(std::ostream& out, const std::vector<int>& numNeurons) const {
+        std::vector<std::vector<uint64_t>> totals(NUM_PHASES, std::vector<uint64_t>(NUM_COUNTERS, 0));
+        bool available = false;
+        for (const threadLog& log : logs) {
+            available |= log.fds[0] >= 0;
+            for (int phase=0; phase < NUM_PHASES; ++phase) {
+                for (int c=0; c < NUM_COUNTERS; ++c) {
+                    totals[phase][c] += log.counters[phase][c];
+                }
+            }
+        }
+        if (!available) {
+            out << "hardware counters unavailable\n";
+            return;
+        }
+
+        /* Every time step ends with a single add_RK of the pyramidal neurons */
+        const int64_t steps = std::max<int64_t>(statistics[ADD_RK_PY].count, 1);
+
+        out << std::left << std::setw(12) << "population" << std::right
+            << std::setw(14) << "cycles" << std::setw(14) << "instructions"
+            << std::setw(8) << "IPC" << std::setw(14) << "cache-misses"
+            << std::setw(14) << "branch-misses" << "   per neuron-step\n";
+        auto line = [&](const char* label, const std::vector<int>& phases, double neuronSteps) {
+            double sum[NUM_COUNTERS] = {0.0};
+            for (int phase : phases) {
+                for (int c=0; c < NUM_COUNTERS; ++c) {
+                    sum[c] += totals[phase][c];
+                }
+            }
+            out << std::left << std::setw(12) << label << std::right << std::fixed
+                << std::setprecision(1)
+                << std::setw(14) << sum[CYCLES]/neuronSteps
+                << std::setw(14) << sum[INSTRUCTIONS]/neuronSteps << std::setprecision(3)
+                << std::setw(8)  << (sum[CYCLES] > 0.0 ? sum[INSTRUCTIONS]/sum[CYCLES] : 0.0)
+                << std::setw(14) << sum[CACHE_MISSES]/neuronSteps
+                << std::setw(14) << sum[BRANCH_MISSES]/neuronSteps << "\n";
+            out.unsetf(std::ios::fixed);
+        };
+        static const char* populations[4] = {"PY", "IN", "TC", "RE"};
+        int total = 0;
+        for (unsigned type=0; type < numNeurons.size() && type < 4; ++type) {
+            line(populations[type], {SET_RK_PY + (int)type, ADD_RK_PY + (int)type},
+                 std::max(1.0, (double)numNeurons[type]*steps));
+            total += numNeurons[type];
+        }
+        line("gather", {PUBLISH, EXCHANGE, SUM, DELIVER}, std::max(1.0, (double)total*steps));
+        line("drive", {DRIVE_INPUT}, std::max(1.0, (double)total*steps));
+    }
+
+    /* Chrome trace event file of the kept events, which can be opened in Perfetto or
+     * chrome://tracing
+     */
+    void writeTrace(const std::string& file, int process = 0) const {
+        std::ofstream out(file);
+        out << "{\"traceEvents\":[";
+        bool first = true;
+        for (const tracedEvent& t : trace) {
+            const event& e = t.e;
+            out << (first ? "\n" : ",\n") << "{\"name\":\"" << name(e.phase)
+                << "\",\"ph\":\"X\",\"pid\":" << process << ",\"tid\":" << t.thread
+                << ",\"ts\":" << 1E-3*e.start << ",\"dur\":" << 1E-3*(e.end - e.start) << "}";
+            first = false;
+        }
+        out << "\n]}\n";
+    }
+
+private:
+    /* Events kept for the trace file */
+    static const size_t MaxTraceEvents = 1 << 20;
+
+    /* Buckets of the histogram of the wall time per octave */
+    static const int BucketsPerOctave = 16;
+    static const int NumBuckets = 64*BucketsPerOctave;
+
+    struct event {
+        int64_t			start;
+        int64_t			end;
+        profilePhase	phase;
+    };
+
+    struct tracedEvent {
+        event	e;
+        int		thread;
+    };
+
+    /* Running statistics of the instances of a phase */
+    struct phaseStatistics {
+        int64_t					count		= 0;	/* Instances of the phase				*/
+        int64_t					samples		= 0;	/* Instances summed over the threads	*/
+        double					span		= 0.0;	/* Wall time of the instances in ns		*/
+        double					work		= 0.0;	/* Work of the threads in ns			*/
+        double					wait		= 0.0;	/* Barrier wait of the threads in ns	*/
+        double					imbalance	= 0.0;	/* Sum of max/mean - 1 of the work		*/
+        std::vector<int64_t>	histogram	= std::vector<int64_t>(NumBuckets, 0);
+    };
+
+    /* Histogram bucket of a wall time in ns */
+    static int bucket(int64_t duration) {
+        if (duration < 1) {
+            return 0;
+        }
+        return std::min(NumBuckets - 1, (int)(BucketsPerOctave*std::log2((double)duration)) + 1);
+    }
+
+    /* Upper bound of the wall time of the given fraction of the instances */
+    static double percentile(const phaseStatistics& stats, double fraction) {
+        const int64_t rank = std::min(stats.count - 1, (int64_t)(fraction*stats.count));
+        int64_t seen = 0;
+        for (int b=0; b < NumBuckets; ++b) {
+            seen += stats.histogram[b];
+            if (seen > rank) {
+                return b == 0 ? 1.0 : std::exp2((double)b/BucketsPerOctave);
+            }
+        }
+        return std::exp2((double)NumBuckets/BucketsPerOctave);
+    }
+
+    /* Every thread appends the events of the current time step to its own log, which are padded
+     * against false sharing
+     */
+    struct alignas(64) threadLog {
+        std::vector<event>	events;
+        uint64_t			counters[NUM_PHASES][NUM_COUNTERS] = {};
+        bool				opened	= false;
+        int					fds[NUM_COUNTERS] = {-1, -1, -1, -1};	/* Counters, the first leads the group	*/
+    };
+
+#ifdef PROFILE_PERF_EVENTS
+    /* Open the counters of the calling thread as a group, so that they are read at once */
+    static void openCounters(threadLog& log) {
+        static const uint64_t configs[NUM_COUNTERS] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        log.opened = true;
+        for (int c=0; c < NUM_COUNTERS; ++c) {
+            perf_event_attr attr = {};
+            attr.type			= PERF_TYPE_HARDWARE;
+            attr.size			= sizeof(attr);
+            attr.config			= configs[c];
+            attr.read_format	= PERF_FORMAT_GROUP;
+            attr.exclude_kernel	= 1;
+            attr.exclude_hv		= 1;
+            log.fds[c] = syscall(__NR_perf_event_open, &attr, 0, -1, log.fds[0], 0);
+            if (log.fds[c] < 0) {
+                closeCounters(log);
+                return;
+            }
+        }
+    }
+
+    /* Close all counters of a thread that have been opened */
+    static void closeCounters(threadLog& log) {
+        for (int& fd : log.fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            fd = -1;
+        }
+    }
+#endif
+
+    static int threadNum(void) {
+#ifdef _OPENMP
+        return omp_get_thread_num();
+#else
+        return 0;
+#endif
+    }
+
+    static int threadCount(void) {
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+    std::chrono::steady_clock::time_point	epoch;
+    std::vector<threadLog>					logs;
+    std::vector<phaseStatistics>			statistics = std::vector<phaseStatistics>(NUM_PHASES);
+    std::vector<tracedEvent>				trace;
+};
+
+inline Profiler& profiler(void) {
+    static Profiler instance;
+    return instance;
+}
+
+/* Records the lifetime of the scope as a phase of the calling thread */
+class profile_scope {
+public:
+    explicit profile_scope(profilePhase p) : phase(p) {
+#ifdef PROFILE_COUNTERS
+        profiler().readCounters(counters);
+#endif
+        start = profiler().now();
+    }
+
+    ~profile_scope() {
+        profiler().record(phase, start, profiler().now());
+#ifdef PROFILE_COUNTERS
+        uint64_t end[NUM_COUNTERS];
+        profiler().readCounters(end);
+        profiler().recordCounters(phase, counters, end);
+#endif
+    }
+
+private:
+    profilePhase	phase;
+    int64_t			start;
+#ifdef PROFILE_COUNTERS
+    uint64_t		counters[NUM_COUNTERS];
+#endif
+};
+
+#if defined(PROFILE_TRACE) && !defined(PROFILE_PHASES)
+#define PROFILE_PHASES
+#endif
+
+#ifdef PROFILE_PHASES
+#define PROFILE_PHASE(phase) profile_scope profile_scope_##phase(phase)
+#else
+#define PROFILE_PHASE(phase)
+#endif
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
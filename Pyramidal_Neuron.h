@@ -22,140 +22,134 @@
 #ifndef PYRAMIDAL_NEURON_H
 #define PYRAMIDAL_NEURON_H
 #pragma once
+#include <array>
 #include <cmath>
 #include <vector>
 
+#include "Channel_Set.h"
+#include "Population_Parameters.h"
+#include "Simd_Lanes.h"
 #include "Inhibitory_Neuron.h"
 #include "Thalamocortical_Neuron.h"
 
 class Inhibitory_Neuron;
 class Reticular_Neuron;
 class Thalamocortical_Neuron;
+class Synaptic_Input;
 
 /******************************************************************************/
 /*			Implementation of the pyramidal neuron after Bazhenov2002 		  */
 /******************************************************************************/
 class Pyramidal_Neuron {
 public:
+    /* Param holds the parameters of every lane, one trial after the other */
     explicit Pyramidal_Neuron(const std::vector<double> &Param)
-    : E_L(Param[0]), g_L(Param[1]), g_sd(Param[2]) {}
-
-    /* Set strength of input current */
-    void	setInput(double I) {Input = I;}
+    : E_L(lane::load(&Param[0], 3)), g_L(lane::load(&Param[1], 3)), g_sd(lane::load(&Param[2], 3)) {}
 
     /* ODE functions */
-    void	set_RK (int);
+    void	set_RK (int, const pyramidalParameters&);
     void 	add_RK (void);
 
 private:
     /* Current functions */
-    double	I_L		(int) const;
-    double	I_Na	(int) const;
-    double	I_K		(int) const;
-    double	I_A		(int) const;
-    double	I_KS	(int) const;
-    double	I_KNa	(int) const;
-    double	I_sd	(int) const;
-
-    double	I_Ca	(int) const;
-    double	I_KCa	(int) const;
-    double	I_NaP	(int) const;
-    double	I_AR	(int) const;
-
-    double	I_AMPA	(int) const;
-    double	I_NMDA	(int) const;
-    double	I_GABA	(int) const;
+    lane	I_L		(int) const;
+    lane	I_Na	(int, const pyramidalParameters&) const;
+    lane	I_K		(int, const pyramidalParameters&) const;
+    lane	I_A		(int, const pyramidalParameters&) const;
+    lane	I_KS	(int, const pyramidalParameters&) const;
+    lane	I_KNa	(int, const pyramidalParameters&) const;
+    lane	I_sd	(int) const;
+
+    lane	I_Ca	(int, const pyramidalParameters&) const;
+    lane	I_KCa	(int, const pyramidalParameters&) const;
+    lane	I_NaP	(int, const pyramidalParameters&) const;
+    lane	I_AR	(int, const pyramidalParameters&) const;
+
+    lane	I_AMPA	(int, const pyramidalParameters&) const;
+    lane	I_NMDA	(int, const pyramidalParameters&) const;
+    lane	I_GABA	(int, const pyramidalParameters&) const;
 
     /* Gating functions */
-    double alpha_h_Na(int) const;
-    double alpha_n_K (int) const;
-    double beta_h_Na (int) const;
-    double beta_n_K  (int) const;
+    lane   alpha_h_Na(int) const;
+    lane   alpha_n_K (int) const;
+    lane   beta_h_Na (int) const;
+    lane   beta_n_K  (int) const;
 
-    double h_A_inf	(int) const;
-    double m_KS_inf	(int) const;
-    double tau_m_KS	(int) const;
+    lane   h_A_inf	(int) const;
+    lane   m_KS_inf	(int) const;
+    lane   tau_m_KS	(int) const;
 
     /* Sodium pump */
-    double Na_pump	(int) const;
+    lane   Na_pump	(int) const;
 
     /* Helper functions */
-    static void add_RK(std::vector<double>& var) {
+    static void add_RK(std::array<lane, 5>& var) {
         var[0] = (-3*var[0] + 2*var[1] + 4*var[2] + 2*var[3] + var[4])/6;
     }
-    static inline std::vector<double> init (double var) {
+    static inline std::array<lane, 5> init (const lane& var) {
         return {var, 0.0, 0.0, 0.0, 0.0};
     }
 
-    /* Connections (Neurons that target THIS Neuron*/
-    std::vector<Pyramidal_Neuron*>  PY_Con;
-    std::vector<Inhibitory_Neuron*> IN_Con;
-    std::vector<Thalamocortical_Neuron*> TC_Con;
+    /* Summed synaptic variables of the neurons that target THIS neuron */
+    lane	tot_s_AMPA	= 0.0;
+    lane	tot_s_NMDA	= 0.0;
+    lane	tot_s_GABA	= 0.0;
+
+    /* External drive and stimulus current, set by External_Drive and Stimulus_Stream */
+    lane	I_ext		= 0.0;
+    lane	I_stim		= 0.0;
+
+    /* Voltage noise of the RK steps and of the final sum, set by Langevin_Noise */
+    lane	noise_RK	= 0.0;
+    lane	noise_add	= 0.0;
+
+    /* Parameters of the individual neuron */
+    const lane	E_L		= -60.95;
+    const lane	g_L		= 66.7E-3;
+    const lane	g_sd	= 1.75E-3;
 
-    /* Parameter constants */
+    /* Parameter constants shared by the population */
     /* Membrane conductivity */
-    const int		C_m		= 1;
+    static constexpr int	C_m		= 1;
 
     /* Averaged membrane area */
-    const double	A_s		= 15E-5;
-    const double	A_d		= 35E-5;
+    static constexpr double	A_s		= 15E-5;
+    static constexpr double	A_d		= 35E-5;
 
     /* Time constants */
-    const int		tau_A	= 15;
+    static constexpr int	tau_A	= 15;
 
     /* Reversal potentials */
-    const double	E_L		= -60.95;
-    const int		E_K		= -100;
-    const int		E_Na	= 55;
-    const int		E_Ca	= 120;
-
-    const int		E_AMPA	= 0.;
-    const int		E_NMDA	= 0.;
-    const int		E_GABA  = -70;
-
-    /* Channel conductivities */
-    const double	g_L		= 66.7E-3;
-    const double	g_Na	= 50.;
-    const double	g_K		= 10.5;
-    const double	g_A		= 1.;
-    const double	g_KS	= 0.0686;
-    const double	g_KNa	= 1.33;
-    const double	g_sd	= 1.75E-3;
-
-    const double	g_Ca	= 0.43;
-    const double	g_KCa	= 0.57;
-    const double	g_NaP	= 68.6E-3;
-    const double	g_AR	= 25.7E-3;
-
-    const double	g_AMPA	= 5.4E-6;
-    const double	g_NMDA	= 0.9E-6;
-    const double	g_GABA	= 4.15E-6;
+    static constexpr int	E_K		= -100;
+    static constexpr int	E_Na	= 55;
+    static constexpr int	E_Ca	= 120;
+
+    static constexpr int	E_AMPA	= 0.;
+    static constexpr int	E_NMDA	= 0.;
+    static constexpr int	E_GABA  = -70;
 
     /* Synapse time constants */
-    const int		tau_AMPA= 2;
-    const int		tau_NMDA= 100;
-    const int		tau_x	= 2;
+    static constexpr int	tau_AMPA= 2;
+    static constexpr int	tau_NMDA= 100;
+    static constexpr int	tau_x	= 2;
 
     /* Calcium related constants */
-    const int		alpha_Ca= 5;
-    const int		tau_Ca	= 150;
-    const double	Ca_0	= 2.4E-4;
-    const double	K_D		= 30.;
+    static constexpr int	alpha_Ca= 5;
+    static constexpr int	tau_Ca	= 150;
+    static constexpr double	Ca_0	= 2.4E-4;
+    static constexpr double	K_D		= 30.;
 
     /* Sodium related constants */
-    const int		alpha_Na= 10;
-    const double	Na_0	= 9.5;
-    const double	R_pump	= 0.018;
-
-    /* Input current */
-    double			Input	= 0.0;
+    static constexpr int	alpha_Na= 10;
+    static constexpr double	Na_0	= 9.5;
+    static constexpr double	R_pump	= 0.018;
 
     /* RK iteration parameters */
-    const std::vector<double> A = {0.5, 0.5, 1.0, 1.0};
-    const std::vector<double> B = {0.75, 0.75, 0.0, 0.0};
+    static constexpr double A[4] = {0.5, 0.5, 1.0, 1.0};
+    static constexpr double B[4] = {0.75, 0.75, 0.0, 0.0};
 
     /* Variables of the neuron */
-    std::vector<double> 	Vd		= init(E_L),		/* Dendritic membrane voltage			*/
+    std::array<lane, 5> 	Vd		= init(E_L),		/* Dendritic membrane voltage			*/
                     Vs		= init(E_L),		/* Somatic membrane voltage				*/
                     Ca		= init(Ca_0),		/* Calcium concentration in dendrite	*/
                     Na		= init(Na_0),		/* Sodium  concentration in soma		*/
@@ -167,10 +161,13 @@ private:
                     s_NMDA	= init(0.0),   	/* Fraction of open NMDA channels		*/
                     x_NMDA	= init(0.0);   	/* Two stage activation of NMDA channels*/
 
-    /* Other neuron types that recieve input from this neuron type */
-    friend class Inhibitory_Neuron;
-    friend class Thalamocortical_Neuron;
-    friend class Reticular_Neuron;
+    /* The synaptic input is collected by Synaptic_Input */
+    friend class Synaptic_Input;
+    friend class External_Drive;
+    friend class Langevin_Noise;
+    friend class Stimulus_Stream;
+    friend struct bz_simulation;
+    friend class Live_Monitor;
 
     friend void get_data(int counter,
                          std::vector<Pyramidal_Neuron>& PY,
@@ -178,11 +175,6 @@ private:
                          std::vector<Thalamocortical_Neuron>& TC,
                          std::vector<Reticular_Neuron>& RE,
                          std::vector<double*> pData);
-
-    friend void connectNeurons(std::vector<Pyramidal_Neuron>& PY,
-                               std::vector<Inhibitory_Neuron>& IN,
-                               std::vector<Thalamocortical_Neuron>& TC,
-                               std::vector<Reticular_Neuron>& RE);
 };
 
 #endif // PYRAMIDAL_NEURON_H
@@ -27,6 +27,9 @@
 /*                                       Random number streams                                      */
 /****************************************************************************************************/
 #pragma once
+#include <array>
+#include <cmath>
+#include <cstdint>
 #include <random>
 
 /******************************************************************************/
@@ -79,3 +82,105 @@ private:
 /******************************************************************************/
 /*                                  end                                       */
 /******************************************************************************/
+
+
+/******************************************************************************/
+/*              Counter-based random numbers (Philox4x32-10)                  */
+/******************************************************************************/
+/* Purposes of the random streams of a neuron */
+enum randomPurpose {
+    PARAMETERS = 0,
+    CONNECTIVITY,
+    POSITION,
+    DRIVE,
+    NOISE
+};
+
+/* Purpose of the stream of a trial of an ensemble, trial 0 draws the numbers of a single run */
+inline uint32_t trialPurpose(randomPurpose purpose, uint32_t trial) {
+    return purpose | trial << 8;
+}
+
+/* NOTE The Philox generator of Salmon et al. (2011) is a bijection of a 128 bit counter under a
+ * 64 bit key. The stream is therefore fully determined by (seed, stream, neuron, purpose), so any
+ * value can be generated independently of all others, in any order and on any thread.
+ */
+class random_stream_counter {
+public:
+    typedef std::array<uint32_t, 4> block;
+
+    /* Constructors */
+    explicit random_stream_counter(uint64_t seed, uint32_t stream, uint32_t neuron,
+                                   uint32_t purpose)
+    : key(seed), counter{{stream, neuron, purpose, 0}} {}
+
+    /* Uniformly distributed number in the open interval (0, 1) */
+    double uniform(void) {
+        if (numUniform == 0) {
+            const block bits = philox(counter, key);
+            counter[3]++;
+            uniforms[0] = to_double(bits[0], bits[1]);
+            uniforms[1] = to_double(bits[2], bits[3]);
+            numUniform	= 2;
+        }
+        return uniforms[--numUniform];
+    }
+
+    /* Normally distributed number (Box-Muller transform) */
+    double normal(double mean, double stddev) {
+        if (hasNormal) {
+            hasNormal = false;
+            return mean + stddev*cachedNormal;
+        }
+        const double radius = std::sqrt(-2.0*std::log(uniform()));
+        const double angle  = 2.0*3.14159265358979323846*uniform();
+        cachedNormal = radius*std::sin(angle);
+        hasNormal	 = true;
+        return mean + stddev*radius*std::cos(angle);
+    }
+
+    /* Philox4x32 with 10 rounds */
+    static block philox(block ctr, uint64_t seed) {
+        uint32_t k0 = (uint32_t)seed;
+        uint32_t k1 = (uint32_t)(seed >> 32);
+        for (int round = 0; round < 10; ++round) {
+            const uint64_t p0 = (uint64_t)0xD2511F53U * ctr[0];
+            const uint64_t p1 = (uint64_t)0xCD9E8D57U * ctr[2];
+            ctr = {{(uint32_t)(p1 >> 32) ^ ctr[1] ^ k0, (uint32_t)p1,
+                    (uint32_t)(p0 >> 32) ^ ctr[3] ^ k1, (uint32_t)p0}};
+            k0 += 0x9E3779B9U;
+            k1 += 0xBB67AE85U;
+        }
+        return ctr;
+    }
+
+    /* Uniform numbers of the counters [first, first + count/2) of a stream, two per counter. The
+     * loop has no dependencies between the counters, so the compiler vectorizes it
+     */
+    static void uniformBlock(uint64_t seed, uint32_t stream, uint32_t neuron, uint32_t purpose,
+                             uint32_t first, int count, double* out) {
+        #pragma omp simd
+        for (int p=0; p < count/2; ++p) {
+            const block bits = philox({{stream, neuron, purpose, first + p}}, seed);
+            out[2*p]   = to_double(bits[0], bits[1]);
+            out[2*p+1] = to_double(bits[2], bits[3]);
+        }
+    }
+
+    /* Map 64 random bits onto (0, 1) with 53 bit resolution */
+    static double to_double(uint32_t hi, uint32_t lo) {
+        const uint64_t bits = ((uint64_t)hi << 32 | lo) >> 11;
+        return (bits + 0.5) * (1.0/9007199254740992.0);
+    }
+
+private:
+    uint64_t	key;
+    block		counter;
+    double		uniforms[2];
+    int			numUniform	 = 0;
+    double		cachedNormal = 0.0;
+    bool		hasNormal	 = false;
+};
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
@@ -0,0 +1,266 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+/****************************************************************************************************/
+/*							Renumbering of the neurons for locality									*/
+/****************************************************************************************************/
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "Network_Image.h"
+#include "Thread_Placement.h"
+
+/* NOTE The neurons of all populations form a single graph, in which every synapse is an undirected
+ * edge. The reverse Cuthill-McKee ordering of this graph places connected neurons close to each
+ * other, so that the presynaptic neurons of a neuron and of its neighbours share cache lines and
+ * the blocks of a decomposed network need smaller halos. Every population keeps its own array, it
+ * is ordered by the position of its neurons within the global ordering.
+ */
+enum neuronOrdering {
+    ORDER_GENERATED = 0,	/* Order in which the neurons were generated		*/
+    ORDER_RCM				/* Reverse Cuthill-McKee over all populations		*/
+};
+
+/* Undirected adjacency of all neurons in CSR form. Neuron i of population pop has the global index
+ * offset[pop] + i
+ */
+struct neuronGraph {
+    std::vector<int>		offset;
+    std::vector<uint64_t>	rows;
+    std::vector<int32_t>	neighbours;
+
+    int		size	(void)	const {return rows.size() - 1;}
+    int		degree	(int n) const {return rows[n+1] - rows[n];}
+};
+
+static neuronGraph getNeuronGraph(const Network_Image& image) {
+    neuronGraph graph;
+    graph.offset.assign(image.numPopulations() + 1, 0);
+    for (int pop=0; pop < image.numPopulations(); ++pop) {
+        graph.offset[pop+1] = graph.offset[pop] + image.numCells(pop);
+    }
+    const int numNeurons = graph.offset.back();
+
+    /* Every synapse enters the rows of both of its neurons */
+    graph.rows.assign(numNeurons + 1, 0);
+    for (int proj=0; proj < image.numProjections(); ++proj) {
+        const int post = graph.offset[image.post(proj)];
+        const int pre  = graph.offset[image.pre (proj)];
+        for (int j=0; j < image.numCells(image.post(proj)); ++j) {
+            for (int i : image.inputs(proj, j)) {
+                graph.rows[post + j + 1]++;
+                graph.rows[pre  + i + 1]++;
+            }
+        }
+    }
+    for (int n=0; n < numNeurons; ++n) {
+        graph.rows[n+1] += graph.rows[n];
+    }
+
+    std::vector<uint64_t> cursor(graph.rows.begin(), graph.rows.end() - 1);
+    graph.neighbours.resize(graph.rows.back());
+    for (int proj=0; proj < image.numProjections(); ++proj) {
+        const int post = graph.offset[image.post(proj)];
+        const int pre  = graph.offset[image.pre (proj)];
+        for (int j=0; j < image.numCells(image.post(proj)); ++j) {
+            for (int i : image.inputs(proj, j)) {
+                graph.neighbours[cursor[post + j]++] = pre  + i;
+                graph.neighbours[cursor[pre  + i]++] = post + j;
+            }
+        }
+    }
+
+    /* Neurons connected by several synapses are neighbours only once */
+    uint64_t write = 0;
+    for (int n=0; n < numNeurons; ++n) {
+        int32_t* first = graph.neighbours.data() + graph.rows[n];
+        int32_t* last  = graph.neighbours.data() + graph.rows[n+1];
+        std::sort(first, last);
+        last = std::unique(first, last);
+        graph.rows[n] = write;
+        write = std::copy(first, last, graph.neighbours.data() + write) - graph.neighbours.data();
+    }
+    graph.rows[numNeurons] = write;
+    graph.neighbours.resize(write);
+
+    /* Cuthill-McKee visits the neighbours in the order of increasing degree */
+    for (int n=0; n < numNeurons; ++n) {
+        std::sort(graph.neighbours.data() + graph.rows[n], graph.neighbours.data() + graph.rows[n+1],
+                  [&graph](int32_t a, int32_t b) {
+                      return graph.degree(a) < graph.degree(b) || (graph.degree(a) == graph.degree(b) && a < b);
+                  });
+    }
+    return graph;
+}
+
+/* Breadth first search from a neuron. Returns the visited neurons level by level, together with
+ * the number of levels and the position of the last level
+ */
+static std::vector<int> breadthFirst(const neuronGraph& graph, int start, std::vector<char>& visited,
+                                     int& depth, size_t& lastLevel) {
+    std::vector<int> order = {start};
+    visited[start] = 1;
+    depth = 0;
+    lastLevel = 0;
+    for (size_t level=0; level < order.size();) {
+        const size_t end = order.size();
+        lastLevel = level;
+        ++depth;
+        for (size_t k=level; k < end; ++k) {
+            const int n = order[k];
+            for (uint64_t e=graph.rows[n]; e < graph.rows[n+1]; ++e) {
+                const int m = graph.neighbours[e];
+                if (!visited[m]) {
+                    visited[m] = 1;
+                    order.push_back(m);
+                }
+            }
+        }
+        level = end;
+    }
+    return order;
+}
+
+/* Order of the neurons of every population after reverse Cuthill-McKee. Entry i of a population
+ * is the current index of the neuron that becomes neuron i
+ */
+static std::vector<std::vector<int>> orderReverseCuthillMcKee(const Network_Image& image) {
+    const neuronGraph graph = getNeuronGraph(image);
+    const int numNeurons = graph.size();
+
+    /* Every connected component starts at a pseudo-peripheral neuron of minimal degree */
+    std::vector<int> candidates(numNeurons);
+    for (int n=0; n < numNeurons; ++n) {
+        candidates[n] = n;
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [&graph](int a, int b) {return graph.degree(a) < graph.degree(b);});
+
+    std::vector<char> visited(numNeurons, 0), probe(numNeurons, 0);
+    std::vector<int> order;
+    order.reserve(numNeurons);
+    for (int start : candidates) {
+        if (visited[start]) {
+            continue;
+        }
+        /* Move the start to the last level of the search as long as the eccentricity grows */
+        int eccentricity = 0, depth = 0;
+        size_t lastLevel = 0;
+        for (int iteration=0; iteration < 8; ++iteration) {
+            std::vector<int> component = breadthFirst(graph, start, probe, depth, lastLevel);
+            for (int n : component) {
+                probe[n] = 0;
+            }
+            if (depth <= eccentricity) {
+                break;
+            }
+            eccentricity = depth;
+            int next = component[lastLevel];
+            for (size_t k=lastLevel; k < component.size(); ++k) {
+                if (graph.degree(component[k]) < graph.degree(next)) {
+                    next = component[k];
+                }
+            }
+            if (next == start) {
+                break;
+            }
+            start = next;
+        }
+        const std::vector<int> component = breadthFirst(graph, start, visited, depth, lastLevel);
+        order.insert(order.end(), component.begin(), component.end());
+    }
+    std::reverse(order.begin(), order.end());
+
+    /* Split the global order into the populations */
+    std::vector<std::vector<int>> populations(image.numPopulations());
+    int pop = 0;
+    std::vector<int> owner(numNeurons);
+    for (int n=0; n < numNeurons; ++n) {
+        while (n >= graph.offset[pop+1]) {
+            ++pop;
+        }
+        owner[n] = pop;
+    }
+    for (int n : order) {
+        populations[owner[n]].push_back(n - graph.offset[owner[n]]);
+    }
+    return populations;
+}
+
+/* Copy of the image with the neurons of every population in the given order */
+static Network_Image renumberNetwork(const Network_Image& image,
+                                     const std::vector<std::vector<int>>& order) {
+    const int numPopulations = image.numPopulations();
+
+    std::vector<int> numCells(numPopulations), numParameters(numPopulations);
+    std::vector<std::vector<int>> inverse(numPopulations);
+    for (int pop=0; pop < numPopulations; ++pop) {
+        numCells[pop]		= image.numCells(pop);
+        numParameters[pop]	= image.numParameters(pop);
+        inverse[pop].resize(numCells[pop]);
+        for (int i=0; i < numCells[pop]; ++i) {
+            inverse[pop][order[pop][i]] = i;
+        }
+    }
+    std::vector<projectionLayout> layout;
+    for (int proj=0; proj < image.numProjections(); ++proj) {
+        layout.push_back({image.post(proj), image.pre(proj), image.numSynapses(proj)});
+    }
+
+    Network_Image result;
+    result.allocate(image.seed(), image.configHash(), numCells, numParameters, layout);
+    for (int pop=0; pop < numPopulations; ++pop) {
+        const int32_t* ids = image.identities(pop);
+        int32_t* newIds = result.identities(pop);
+        for (int i=0; i < numCells[pop]; ++i) {
+            const double* parameters = image.parameters(pop, order[pop][i]);
+            std::copy(parameters, parameters + numParameters[pop], result.parameters(pop, i));
+            newIds[i] = ids[order[pop][i]];
+        }
+    }
+
+    for (int proj=0; proj < image.numProjections(); ++proj) {
+        const int post = image.post(proj);
+        const std::vector<int>& preIndex = inverse[image.pre(proj)];
+        uint64_t* rows = result.rows(proj);
+        int32_t* indices = result.indices(proj);
+        rows[0] = 0;
+        for (int j=0; j < numCells[post]; ++j) {
+            rows[j+1] = rows[j] + image.inputs(proj, order[post][j]).size();
+        }
+        #pragma omp parallel for num_threads(runThreads()) schedule(static)
+        for (int j=0; j < numCells[post]; ++j) {
+            int32_t* row = indices + rows[j];
+            for (int i : image.inputs(proj, order[post][j])) {
+                *row++ = preIndex[i];
+            }
+            std::sort(indices + rows[j], row);
+        }
+    }
+    return result;
+}
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
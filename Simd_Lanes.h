@@ -0,0 +1,134 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+/****************************************************************************************************/
+/*							SIMD lanes of the trials of an ensemble									*/
+/****************************************************************************************************/
+#pragma once
+#include <cmath>
+
+/* NOTE The neuron models store every variable as a lane of values, one per trial of an ensemble,
+ * so the trials of a neuron sit next to each other within a single neuron object. All arithmetic
+ * on lanes is elementwise, so every operation of set_RK and add_RK is a short vector loop over the
+ * trials, which the compiler maps onto SIMD instructions. The number of lanes is fixed at compile
+ * time, e.g. -DLANES=4 for AVX2 or -DLANES=8 for AVX-512, and the number of trials must be a
+ * multiple of it. A single lane, the default, reduces every lane to a double and gives the results
+ * of the scalar models bit by bit.
+ *
+ * exp and pow are evaluated lane by lane with the scalar functions of the math library. They only
+ * turn into vector calls if the compiler may use a vector math library (-ffast-math with libmvec),
+ * which gives up bitwise reproducibility.
+ */
+#ifndef LANES
+#define LANES	1
+#endif
+
+template<int K>
+struct lanes {
+    double v[K];
+
+    lanes() = default;
+    lanes(double x) {
+        #pragma omp simd
+        for (int k=0; k < K; ++k) v[k] = x;
+    }
+
+    /* Lanes from every stride-th value of x */
+    static lanes load(const double* x, int stride = 1) {
+        lanes r;
+        for (int k=0; k < K; ++k) r.v[k] = x[k*stride];
+        return r;
+    }
+    void store(double* x) const {
+        #pragma omp simd
+        for (int k=0; k < K; ++k) x[k] = v[k];
+    }
+
+    double& 	  operator[](int k)		  {return v[k];}
+    const double& operator[](int k) const {return v[k];}
+
+    lanes& operator+=(const lanes& x) {
+        #pragma omp simd
+        for (int k=0; k < K; ++k) v[k] += x.v[k];
+        return *this;
+    }
+
+    friend lanes operator-(const lanes& x) {
+        lanes r;
+        #pragma omp simd
+        for (int k=0; k < K; ++k) r.v[k] = -x.v[k];
+        return r;
+    }
+    friend lanes operator+(const lanes& a, const lanes& b) {
+        lanes r;
+        #pragma omp simd
+        for (int k=0; k < K; ++k) r.v[k] = a.v[k] + b.v[k];
+        return r;
+    }
+    friend lanes operator-(const lanes& a, const lanes& b) {
+        lanes r;
+        #pragma omp simd
+        for (int k=0; k < K; ++k) r.v[k] = a.v[k] - b.v[k];
+        return r;
+    }
+    friend lanes operator*(const lanes& a, const lanes& b) {
+        lanes r;
+        #pragma omp simd
+        for (int k=0; k < K; ++k) r.v[k] = a.v[k] * b.v[k];
+        return r;
+    }
+    friend lanes operator/(const lanes& a, const lanes& b) {
+        lanes r;
+        #pragma omp simd
+        for (int k=0; k < K; ++k) r.v[k] = a.v[k] / b.v[k];
+        return r;
+    }
+
+    friend lanes exp(const lanes& x) {
+        lanes r;
+        #pragma omp simd
+        for (int k=0; k < K; ++k) r.v[k] = std::exp(x.v[k]);
+        return r;
+    }
+    friend lanes pow(const lanes& x, double y) {
+        lanes r;
+        #pragma omp simd
+        for (int k=0; k < K; ++k) r.v[k] = std::pow(x.v[k], y);
+        return r;
+    }
+
+    /* a >= b ? x : y in every lane, both branches are evaluated */
+    friend lanes selectGreaterEqual(const lanes& a, const lanes& b, const lanes& x, const lanes& y) {
+        lanes r;
+        #pragma omp simd
+        for (int k=0; k < K; ++k) r.v[k] = a.v[k] >= b.v[k] ? x.v[k] : y.v[k];
+        return r;
+    }
+};
+
+/* Lanes of the neuron models and their number */
+constexpr int Lanes = LANES;
+typedef lanes<Lanes> lane;
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
@@ -0,0 +1,223 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+/****************************************************************************************************/
+/*							Spatial layout of the neuron populations								*/
+/****************************************************************************************************/
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "Random_Stream.h"
+
+/* Arrangement of the neurons in space */
+enum networkLayout {
+    RING = 0,	/* One dimensional ring, connectivity given by the neuron index	*/
+    SHEET,		/* Two dimensional sheet with periodic boundaries				*/
+    COLUMN		/* Three dimensional column, periodic in x and y				*/
+};
+
+struct point {
+    double x, y, z;
+};
+
+/* NOTE In the planar layouts every population is placed on a jittered grid that spans the whole
+ * extent x extent x depth box, so that projections are topographic. The pyramidal cells have a
+ * spacing of about 5 units, which matches the ring of length 5*NumCells[PYRAMIDAL]. A plane holds
+ * side x side neurons, the column stacks as many planes as needed evenly over its depth. A partially
+ * filled plane is laid out in rows over the whole plane, and the neurons of a partially filled row
+ * are spread evenly along it, so no region of the box is left empty and the nearest neuron of a
+ * gaussian offset is always close by. Neurons are sorted into a cell list of side x side x layers
+ * cells, so the neuron closest to an arbitrary point is found in constant time.
+ */
+class Spatial_Layout {
+public:
+    /* Ring layout, which does not need any spatial information */
+    Spatial_Layout() = default;
+
+    Spatial_Layout(networkLayout layout, const std::vector<int>& numCells, uint64_t seed)
+    : type(layout) {
+        if (type == RING) {
+            return;
+        }
+        const int dimensions = type == SHEET ? 2 : 3;
+        extent = 5.0*std::pow((double)numCells[0], 1.0/dimensions);
+        depth  = type == SHEET ? 0.0 : extent;
+
+        grids.resize(numCells.size());
+        for (unsigned pop=0; pop < numCells.size(); ++pop) {
+            buildGrid(grids[pop], pop, numCells[pop], dimensions, seed);
+        }
+    }
+
+    networkLayout	layout	(void)				   const {return type;}
+    const point&	position(int pop, int neuron) const {return grids[pop].positions[neuron];}
+
+    /* Neuron of population pop that is closest to p */
+    int nearest(int pop, point p) const {
+        const grid& g = grids[pop];
+        p.x = wrap(p.x);
+        p.y = wrap(p.y);
+        p.z = type == SHEET ? 0.0 : std::min(std::max(p.z, 0.0), std::nextafter(depth, 0.0));
+        const int cx = std::min((int)(p.x/g.spacing), g.side - 1);
+        const int cy = std::min((int)(p.y/g.spacing), g.side - 1);
+        const int cz = g.layers > 1 ? std::min((int)(p.z/g.height), g.layers - 1) : 0;
+
+        /* Search shells of cells with increasing distance. Every point outside of shell r is at
+         * least r times the smallest cell edge plus margin away, so the search stops once a
+         * closer neuron has been found
+         */
+        double margin = std::min(std::min(p.x - cx*g.spacing, (cx + 1)*g.spacing - p.x),
+                                 std::min(p.y - cy*g.spacing, (cy + 1)*g.spacing - p.y));
+        double edge = g.spacing;
+        if (g.layers > 1) {
+            margin = std::min(margin, std::min(p.z - cz*g.height, (cz + 1)*g.height - p.z));
+            edge   = std::min(edge, g.height);
+        }
+        margin = std::max(margin, 0.0);
+        int    best		= -1;
+        double bestDist	= std::numeric_limits<double>::max();
+        const int maxShell = std::max(g.side, g.layers);
+        for (int r = 0; r <= maxShell; ++r) {
+            const int rz = g.layers > 1 ? r : 0;
+            for (int dz = -rz; dz <= rz; ++dz) {
+                const int z = cz + dz;
+                if (z < 0 || z >= g.layers) {
+                    continue;
+                }
+                for (int dy = -r; dy <= r; ++dy) {
+                    for (int dx = -r; dx <= r; ++dx) {
+                        if (std::max(std::abs(dx), std::max(std::abs(dy), std::abs(dz))) != r) {
+                            continue;
+                        }
+                        const int cell = cellIndex(g, cx + dx, cy + dy, z);
+                        for (int k = g.start[cell]; k < g.start[cell+1]; ++k) {
+                            const int neuron = g.neurons[k];
+                            const double dist = distance2(p, g.positions[neuron]);
+                            if (dist < bestDist || (dist == bestDist && neuron < best)) {
+                                bestDist = dist;
+                                best	 = neuron;
+                            }
+                        }
+                    }
+                }
+            }
+            const double reach = r*edge + margin;
+            if (best >= 0 && bestDist <= reach*reach) {
+                break;
+            }
+        }
+        return best;
+    }
+
+private:
+    /* Jittered grid and cell list of a single population */
+    struct grid {
+        int					side	= 0;	/* Number of cells along x and y	*/
+        int					layers	= 0;	/* Number of cells along z			*/
+        double				spacing	= 0.0;	/* Edge length of a cell in x and y	*/
+        double				height	= 0.0;	/* Edge length of a cell in z		*/
+        std::vector<point>	positions;		/* Position of every neuron			*/
+        std::vector<int>	start;			/* First entry of every cell		*/
+        std::vector<int>	neurons;		/* Neurons sorted by cell			*/
+    };
+
+    void buildGrid(grid& g, int pop, int numCells, int dimensions, uint64_t seed) const {
+        g.side	  = std::max(1, (int)std::ceil(std::pow((double)numCells, 1.0/dimensions) - 1E-9));
+        g.layers  = dimensions == 2 ? 1 : (numCells + g.side*g.side - 1)/(g.side*g.side);
+        g.spacing = extent/g.side;
+        g.height  = dimensions == 2 ? 0.0 : depth/g.layers;
+
+        /* Place every neuron at its grid point with a jitter of a quarter spacing. The rows of a
+         * plane and the neurons of a row are spread over the whole extent
+         */
+        const int perPlane = dimensions == 2 ? numCells : g.side*g.side;
+        g.positions.resize(numCells);
+        for (int i = 0; i < numCells; ++i) {
+            random_stream_counter RNG(seed, pop, i, POSITION);
+            const int iz	  = i / perPlane;
+            const int inPlane = std::min(perPlane, numCells - iz*perPlane);
+            const int columns = std::max(1, (int)std::ceil(std::sqrt((double)inPlane) - 1E-9));
+            const int rows	  = (inPlane + columns - 1)/columns;
+            const int k		  = i % perPlane;
+            const int iy	  = k / columns;
+            const int inRow	  = std::min(columns, inPlane - iy*columns);
+            const int ix	  = k % columns;
+            g.positions[i].x = (ix + 0.5 + 0.5*(RNG.uniform() - 0.5))*extent/inRow;
+            g.positions[i].y = (iy + 0.5 + 0.5*(RNG.uniform() - 0.5))*extent/rows;
+            g.positions[i].z = dimensions == 2 ? 0.0
+                             : (iz + 0.5 + 0.5*(RNG.uniform() - 0.5))*g.height;
+        }
+
+        /* Sort the neurons into the cells (counting sort) */
+        std::vector<int> cells(numCells);
+        g.start.assign(g.side*g.side*g.layers + 1, 0);
+        for (int i = 0; i < numCells; ++i) {
+            const point& p = g.positions[i];
+            cells[i] = cellIndex(g, std::min((int)(p.x/g.spacing), g.side - 1),
+                                 std::min((int)(p.y/g.spacing), g.side - 1),
+                                 g.layers > 1 ? std::min((int)(p.z/g.height), g.layers - 1) : 0);
+            g.start[cells[i] + 1]++;
+        }
+        for (unsigned c = 1; c < g.start.size(); ++c) {
+            g.start[c] += g.start[c-1];
+        }
+        std::vector<int> next(g.start.begin(), g.start.end() - 1);
+        g.neurons.resize(numCells);
+        for (int i = 0; i < numCells; ++i) {
+            g.neurons[next[cells[i]]++] = i;
+        }
+    }
+
+    /* Index of a cell, periodic in x and y */
+    static int cellIndex(const grid& g, int x, int y, int z) {
+        x = ((x % g.side) + g.side) % g.side;
+        y = ((y % g.side) + g.side) % g.side;
+        return (z*g.side + y)*g.side + x;
+    }
+
+    double wrap(double x) const {
+        x = std::fmod(x, extent);
+        return x < 0 ? std::min(x + extent, std::nextafter(extent, 0.0)) : x;
+    }
+
+    /* Squared distance with periodic boundaries in x and y */
+    double distance2(const point& a, const point& b) const {
+        double dx = std::fabs(a.x - b.x);
+        double dy = std::fabs(a.y - b.y);
+        dx = std::min(dx, extent - dx);
+        dy = std::min(dy, extent - dy);
+        return dx*dx + dy*dy + (a.z - b.z)*(a.z - b.z);
+    }
+
+    networkLayout		type	= RING;
+    double				extent	= 0.0;	/* Edge length of the sheet		*/
+    double				depth	= 0.0;	/* Depth of the column			*/
+    std::vector<grid>	grids;
+};
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
@@ -0,0 +1,402 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+
+/****************************************************************************************************/
+/*									Time varying stimulation										*/
+/****************************************************************************************************/
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Connectivity.h"
+#include "Domain_Decomposition.h"
+#include "Network_Image.h"
+#include "Simd_Lanes.h"
+
+/* NOTE A stimulus file holds the input current of the neurons in muA/cm^2 as a function of time.
+ * It is a single block, that is mapped read-only, so it may be far larger than the memory
+ *
+ *		stimulusHeader
+ *		samples	float [numRecords x numChannels]	for STIMULUS_POPULATION and STIMULUS_NEURON
+ *		events	stimulusEvent [numRecords]			for STIMULUS_EVENTS, sorted by their start
+ *
+ * Sample k is the current at time k*interval, one channel per population or per neuron. The
+ * channels of the neurons are ordered by population and then by the generated id of the neurons,
+ * so a file stays valid if the network is renumbered. Between two samples the current is either
+ * held or linearly interpolated, after the last sample it is zero. Events are rectangular pulses
+ * onto a single neuron or a whole population, which suits pulse protocols with long pauses.
+ *
+ * The current is evaluated at the time of every RK step and applied to every trial of an
+ * ensemble. The kernel is advised to read ahead a window of the file, and the pages that have been
+ * passed are released again, so the time steps neither wait for the disk nor fill the memory.
+ */
+enum stimulusEncoding {
+    STIMULUS_POPULATION = 0,	/* Samples of every population							*/
+    STIMULUS_NEURON,			/* Samples of every neuron								*/
+    STIMULUS_EVENTS				/* Rectangular pulses									*/
+};
+
+enum stimulusInterpolation {
+    INTERPOLATE_HOLD = 0,		/* Hold a sample until the next one						*/
+    INTERPOLATE_LINEAR			/* Linear interpolation between the samples				*/
+};
+
+struct stimulusHeader {
+    char		magic[8];
+    uint32_t	version;
+    uint32_t	encoding;
+    uint32_t	interpolation;
+    uint32_t	numChannels;
+    double		interval;		/* Time between two samples in ms				*/
+    uint64_t	numRecords;		/* Number of samples or events					*/
+    uint64_t	dataOffset;
+};
+
+struct stimulusEvent {
+    double		start;			/* Onset in ms									*/
+    double		duration;		/* Length in ms									*/
+    int32_t		population;
+    int32_t		neuron;			/* Generated id of the neuron, -1 for all		*/
+    double		amplitude;		/* Current in muA/cm^2							*/
+};
+
+class Stimulus_Stream {
+public:
+    static const uint32_t Version = 1;
+
+    Stimulus_Stream() = default;
+    Stimulus_Stream(const Stimulus_Stream&) = delete;
+    Stimulus_Stream& operator=(const Stimulus_Stream&) = delete;
+    ~Stimulus_Stream() {release();}
+
+    /* Map a stimulus file for the owned neurons of a network and every trial of an ensemble */
+    void open(const std::string& file, const Network_Image& image, Domain& domain,
+              int trials = 1) {
+        release();
+        map(file);
+        if (!valid(image)) {
+            release();
+            throw std::runtime_error("Invalid stimulus file " + file + "!");
+        }
+
+        blocks = trials/Lanes;
+        int offset = 0;
+        for (int type=0; type < image.numPopulations(); ++type) {
+            first[type] = domain.first(type);
+            owned[type] = domain.last(type) - domain.first(type);
+            channels[type].clear();
+            for (int i=0; i < owned[type]; ++i) {
+                channels[type].push_back(offset + image.identities(type)[first[type] + i]);
+            }
+            local[type].assign(image.numCells(type), -1);
+            for (int i=0; i < owned[type]; ++i) {
+                local[type][image.identities(type)[first[type] + i]] = i;
+            }
+            eventLevel[type].assign(owned[type], 0.0);
+            offset += image.numCells(type);
+        }
+        step	= 0;
+        cursor	= 0;
+        running.clear();
+        ahead	= 0;
+        released= 0;
+    }
+
+    bool active(void) const {return data != nullptr;}
+
+    /* Stop the stimulation */
+    void close(void) {release();}
+
+    /* Evaluate the stimulus at the time of RK step N of the current time step */
+    void prepare(int N) {
+        extern const double dt;
+        static const double Offset[4] = {0.0, 0.5, 0.5, 1.0};
+        const double time = (step + Offset[N])*dt;
+        const stimulusHeader& head = header();
+
+        if (head.encoding == STIMULUS_EVENTS) {
+            updateEvents(time);
+            readahead(head.dataOffset + cursor*sizeof(stimulusEvent));
+            return;
+        }
+
+        /* Rows and weights of the samples around the current time */
+        const double position = time/head.interval;
+        const uint64_t k = (uint64_t)position;
+        weight = head.interpolation == INTERPOLATE_LINEAR ? position - k : 0.0;
+        rowA = k     < head.numRecords ? samples() + k*head.numChannels		 : nullptr;
+        rowB = k + 1 < head.numRecords ? samples() + (k + 1)*head.numChannels : nullptr;
+        readahead(head.dataOffset + k*head.numChannels*sizeof(float));
+    }
+
+    /* Set the stimulus of the neurons of a population. The loop has no barrier */
+    template<class NEURON>
+    void apply(std::vector<NEURON>& neurons, neuronType type) {
+        const stimulusHeader& head = header();
+        if (head.encoding == STIMULUS_EVENTS) {
+            const double* level = eventLevel[type].data();
+            #pragma omp for schedule(static) nowait
+            for (unsigned i=0; i < neurons.size(); ++i) {
+                neurons[i].I_stim = level[i/blocks];
+            }
+            return;
+        }
+
+        const int* channel = channels[type].data();
+        const bool perNeuron = head.encoding == STIMULUS_NEURON;
+        #pragma omp for schedule(static) nowait
+        for (unsigned i=0; i < neurons.size(); ++i) {
+            const int c = perNeuron ? channel[i/blocks] : (int)type;
+            const double a = rowA ? rowA[c] : 0.0;
+            const double b = rowB ? rowB[c] : 0.0;
+            neurons[i].I_stim = a + weight*(b - a);
+        }
+    }
+
+    /* Move on to the next time step */
+    void advance(void) {++step;}
+
+    /* Write a file of samples with numChannels channels per sample */
+    static void writeSamples(const std::string& file, stimulusEncoding encoding,
+                             stimulusInterpolation interpolation, double interval,
+                             uint32_t numChannels, const std::vector<float>& samples) {
+        stimulusHeader head = makeHeader(encoding, samples.size()/std::max(numChannels, 1U));
+        head.interpolation	= interpolation;
+        head.numChannels	= numChannels;
+        head.interval		= interval;
+        write(file, head, samples.data(), samples.size()*sizeof(float));
+    }
+
+    /* Write a file of events */
+    static void writeEvents(const std::string& file, std::vector<stimulusEvent> events) {
+        std::stable_sort(events.begin(), events.end(),
+                         [](const stimulusEvent& a, const stimulusEvent& b) {return a.start < b.start;});
+        write(file, makeHeader(STIMULUS_EVENTS, events.size()), events.data(),
+              events.size()*sizeof(stimulusEvent));
+    }
+
+private:
+    static const char* magic(void) {return "BZSTIMUL";}
+
+    /* Window of the file that is read ahead */
+    static const uint64_t Readahead = 32ULL << 20;
+
+    const stimulusHeader& header(void) const {return *reinterpret_cast<const stimulusHeader*>(data);}
+    const float* samples(void) const {return reinterpret_cast<const float*>(data + header().dataOffset);}
+    const stimulusEvent* events(void) const {
+        return reinterpret_cast<const stimulusEvent*>(data + header().dataOffset);
+    }
+
+    void map(const std::string& file) {
+#ifdef NETWORK_IMAGE_MMAP
+        int fd = ::open(file.c_str(), O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(stimulusHeader)) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            throw std::runtime_error("Could not open stimulus file " + file + "!");
+        }
+        void* region = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (region == MAP_FAILED) {
+            throw std::runtime_error("Could not map stimulus file " + file + "!");
+        }
+        madvise(region, info.st_size, MADV_SEQUENTIAL);
+        data	= static_cast<char*>(region);
+        size	= info.st_size;
+        mapped	= true;
+#else
+        /* Without mapping the file has to fit into memory */
+        std::ifstream in(file, std::ios::binary | std::ios::ate);
+        if (!in) {
+            throw std::runtime_error("Could not open stimulus file " + file + "!");
+        }
+        size = in.tellg();
+        storage.resize((size + sizeof(uint64_t) - 1)/sizeof(uint64_t));
+        data = reinterpret_cast<char*>(storage.data());
+        in.seekg(0);
+        in.read(data, size);
+#endif
+    }
+
+    /* Check the header, the size and, for events, their targets */
+    bool valid(const Network_Image& image) const {
+        const stimulusHeader& head = header();
+        if (std::memcmp(head.magic, magic(), sizeof(head.magic)) != 0 || head.version != Version
+            || head.encoding > STIMULUS_EVENTS || head.interpolation > INTERPOLATE_LINEAR
+            || head.dataOffset < sizeof(stimulusHeader) || head.dataOffset > size) {
+            return false;
+        }
+        if (head.encoding == STIMULUS_EVENTS) {
+            if (head.numRecords > (size - head.dataOffset)/sizeof(stimulusEvent)) {
+                return false;
+            }
+            for (uint64_t e=0; e < head.numRecords; ++e) {
+                const stimulusEvent& event = events()[e];
+                if (event.population < 0 || event.population >= image.numPopulations()
+                    || event.neuron < -1 || event.neuron >= image.numCells(event.population)
+                    || (e > 0 && event.start < events()[e-1].start)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        int numCells = 0;
+        for (int type=0; type < image.numPopulations(); ++type) {
+            numCells += image.numCells(type);
+        }
+        const uint32_t expected = head.encoding == STIMULUS_POPULATION ? image.numPopulations() : numCells;
+        return head.numChannels == expected && head.interval > 0.0
+               && head.numRecords <= (size - head.dataOffset)/(sizeof(float)*head.numChannels);
+    }
+
+    /* Start and end the events up to the given time. The current of the neurons is only
+     * recomputed when the set of active events changed
+     */
+    void updateEvents(double time) {
+        const stimulusHeader& head = header();
+        bool changed = false;
+        while (cursor < head.numRecords && events()[cursor].start <= time) {
+            running.push_back(cursor++);
+            changed = true;
+        }
+        for (unsigned a=0; a < running.size(); ) {
+            const stimulusEvent& event = events()[running[a]];
+            if (event.start + event.duration <= time) {
+                running.erase(running.begin() + a);
+                changed = true;
+            } else {
+                ++a;
+            }
+        }
+        if (!changed) {
+            return;
+        }
+
+        for (auto &level : eventLevel) {
+            std::fill(level.begin(), level.end(), 0.0);
+        }
+        for (uint64_t index : running) {
+            const stimulusEvent& event = events()[index];
+            std::vector<double>& level = eventLevel[event.population];
+            if (event.neuron < 0) {
+                for (double& value : level) {
+                    value += event.amplitude;
+                }
+            } else if (local[event.population][event.neuron] >= 0) {
+                level[local[event.population][event.neuron]] += event.amplitude;
+            }
+        }
+    }
+
+    /* Advise the kernel to read the window ahead of the current position of the file, and
+     * release the pages that lie well behind it
+     */
+    void readahead(uint64_t position) {
+#ifdef NETWORK_IMAGE_MMAP
+        if (position + Readahead/2 < ahead || ahead >= size) {
+            return;
+        }
+        const uint64_t page  = sysconf(_SC_PAGESIZE);
+        const uint64_t begin = position/page*page;
+        const uint64_t end	 = std::min(size, begin + Readahead);
+        madvise(data + begin, end - begin, MADV_WILLNEED);
+        if (begin > released + Readahead) {
+            const uint64_t behind = (begin - Readahead)/page*page;
+            madvise(data + released, behind - released, MADV_DONTNEED);
+            released = behind;
+        }
+        ahead = end;
+#else
+        (void)position;
+#endif
+    }
+
+    static stimulusHeader makeHeader(stimulusEncoding encoding, uint64_t numRecords) {
+        stimulusHeader head;
+        std::memset(&head, 0, sizeof(head));
+        std::memcpy(head.magic, magic(), sizeof(head.magic));
+        head.version	= Version;
+        head.encoding	= encoding;
+        head.interval	= 1.0;
+        head.numRecords	= numRecords;
+        head.dataOffset	= sizeof(stimulusHeader);
+        return head;
+    }
+
+    static void write(const std::string& file, const stimulusHeader& head, const void* records,
+                      uint64_t bytes) {
+        std::ofstream out(file, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+        out.write(static_cast<const char*>(records), bytes);
+        if (!out) {
+            throw std::runtime_error("Could not write stimulus file " + file + "!");
+        }
+    }
+
+    void release(void) {
+#ifdef NETWORK_IMAGE_MMAP
+        if (mapped) {
+            munmap(data, size);
+        }
+#endif
+        storage.clear();
+        data	= nullptr;
+        size	= 0;
+        mapped	= false;
+    }
+
+    /* Stimulus either owned in memory or mapped from disk */
+    std::vector<uint64_t>	storage;
+    char*					data	= nullptr;
+    uint64_t				size	= 0;
+    bool					mapped	= false;
+    uint64_t				ahead	= 0;	/* End of the window that is read ahead		*/
+    uint64_t				released= 0;	/* Start of the pages that are still mapped	*/
+
+    /* Owned neurons */
+    int						first[4] = {}, owned[4] = {};
+    std::vector<int>		channels[4];	/* Channel of every owned neuron			*/
+    std::vector<int>		local[4];		/* Owned index of every generated id, or -1	*/
+    unsigned				blocks	= 1;	/* Neuron objects of the trials of a neuron	*/
+
+    /* Current time step and the samples or events of the current RK step */
+    int64_t					step	= 0;
+    const float*			rowA	= nullptr;
+    const float*			rowB	= nullptr;
+    double					weight	= 0.0;
+    uint64_t				cursor	= 0;	/* Next event that has not started			*/
+    std::vector<uint64_t>	running;		/* Events that are running					*/
+    std::vector<double>		eventLevel[4];	/* Current of the owned neurons from events	*/
+};
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
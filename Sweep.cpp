@@ -0,0 +1,213 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+/****************************************************************************************************/
+/*		Parameter sweep over the run settings														*/
+/*																									*/
+/*		Compile as the main file, e.g.																*/
+/*		g++ -std=c++11 -O2 -fopenmp Sweep.cpp *_Neuron.cpp -o Sweep									*/
+/*																									*/
+/*		Sweep [--seeds 1,2] [--drive none,poisson,ou] [--noise 0,0.1] [--set PY.g_KNa=1,1.33]		*/
+/*			  [--sigma 0.5,1] [--steps 50000] [--output .]											*/
+/*																									*/
+/*		Runs every combination of the seeds, drives, noise amplitudes, conductances and connection	*/
+/*		widths and writes the summary of point i to sweep_i.json in the output directory. --set		*/
+/*		may be given for several conductances, --sigma scales the widths of all populations.		*/
+/****************************************************************************************************/
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Parameter_Sweep.h"
+
+/****************************************************************************************************/
+/*										Fixed simulation settings									*/
+/****************************************************************************************************/
+extern const int T		= 1;								/* Simulation length in s				*/
+extern const int res 	= 5E4;								/* Number of iteration steps per s		*/
+extern const double dt 	= 1E3/res;							/* Duration of a timestep in ms			*/
+extern const std::vector<int> NumCells = {128,				/* Number of pyramidal cells			*/
+                                         32,				/* Number of inhibitory cells			*/
+                                         128,				/* Number of thalamocortical cells		*/
+                                         32};				/* Number of reticular cells			*/
+extern const int N_Cores= 7;								/* Number of CPU cores					*/
+extern const unsigned Seed = 1;								/* Seed of the network generation		*/
+extern const std::string NetworkCache = ".";				/* Directory of cached network images	*/
+extern const bool ProceduralConnectivity = false;			/* Regenerate synapses on the fly		*/
+extern const networkLayout Layout = RING;					/* Spatial arrangement of the neurons	*/
+extern const threadPinning Pinning = PIN_NONE;				/* Binding of the threads to cores		*/
+extern const neuronOrdering Ordering = ORDER_GENERATED;		/* Numbering of the neurons				*/
+extern const gatherEngine Engine = GATHER_AUTO;			/* Summation of the synaptic input		*/
+extern const propagationMode Propagation = PROPAGATE_PULL;	/* Pull or push the synaptic input		*/
+extern const double DeltaTolerance = 1E-6;					/* Smallest pushed synaptic change		*/
+extern const int ResyncInterval = 100;						/* Steps between full input summations	*/
+extern const std::vector<driveSettings> Drive(4, {DRIVE_NONE, 0.0, 0.0, 0.0, 0.0, 5.0});	/* External drive	*/
+extern const std::vector<double> VoltageNoise = {0.0, 0.0, 0.0, 0.0};	/* Voltage noise in mV/sqrt(ms)		*/
+extern const std::string StimulusFile = "";				/* Stimulus currents, empty for none	*/
+extern const int Trials = 1;								/* Number of trials of the ensemble		*/
+extern const double WarmupTime = 0.0;						/* Discarded transient in ms, 0 for none	*/
+extern const int N_Ranks = 1;								/* Number of processes (shared memory)	*/
+/****************************************************************************************************/
+/*										 		end			 										*/
+/****************************************************************************************************/
+
+
+/****************************************************************************************************/
+/*										Points of the sweep											*/
+/****************************************************************************************************/
+/* Comma separated list of names */
+static std::vector<std::string> parseNames(const std::string& list) {
+    std::vector<std::string> names;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        names.push_back(item);
+    }
+    return names;
+}
+
+/* Comma separated list of numbers */
+static std::vector<double> parseValues(const std::string& list) {
+    std::vector<double> values;
+    for (const std::string& value : parseNames(list)) {
+        values.push_back(std::stod(value));
+    }
+    return values;
+}
+
+/* Conductances of every combination of the given values. Every entry is a name like "PY.g_KNa"
+ * with the values it takes
+ */
+static std::vector<populationParameters> getParameters(
+        const std::vector<std::pair<std::string, std::vector<double>>>& conductances) {
+    std::vector<populationParameters> parameters = {populationParameters()};
+    for (const auto &conductance : conductances) {
+        std::vector<populationParameters> combined;
+        for (const populationParameters& base : parameters) {
+            for (double value : conductance.second) {
+                combined.push_back(base);
+                double* parameter = findParameter(combined.back(), conductance.first);
+                if (!parameter) {
+                    throw std::runtime_error("Unknown parameter " + conductance.first + "!");
+                }
+                *parameter = value;
+            }
+        }
+        parameters = combined;
+    }
+    return parameters;
+}
+
+/* Drive of all populations, "none", "poisson" or "ou" */
+static std::vector<driveSettings> getDrive(const std::string& name) {
+    if (name != "none" && name != "poisson" && name != "ou") {
+        throw std::runtime_error("Unknown drive " + name + "!");
+    }
+    const driveMode mode = name == "poisson" ? DRIVE_POISSON : name == "ou" ? DRIVE_OU : DRIVE_NONE;
+    return std::vector<driveSettings>(4, {mode, 2000.0, 0.5, 0.5, 1.0, 5.0});
+}
+/****************************************************************************************************/
+/*										 		end			 										*/
+/****************************************************************************************************/
+
+
+/****************************************************************************************************/
+/*										Main sweep routine											*/
+/****************************************************************************************************/
+int main(int argc, char** argv) {
+    std::vector<unsigned> seeds = {Seed};
+    std::vector<std::vector<driveSettings>> drives = {Drive};
+    std::vector<std::string> driveNames;
+    std::vector<std::vector<double>> noises = {VoltageNoise};
+    std::vector<std::pair<std::string, std::vector<double>>> conductances;
+    std::vector<std::vector<double>> widths = {defaultWidths()};
+    std::string output = ".";
+    int steps = T*res;
+    for (int i=1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--seeds" && i + 1 < argc) {
+            seeds.clear();
+            for (const std::string& seed : parseNames(argv[++i])) {
+                seeds.push_back(std::stoul(seed));
+            }
+        } else if (arg == "--drive" && i + 1 < argc) {
+            driveNames = parseNames(argv[++i]);
+        } else if (arg == "--noise" && i + 1 < argc) {
+            noises.clear();
+            for (double noise : parseValues(argv[++i])) {
+                noises.push_back(std::vector<double>(4, noise));
+            }
+        } else if (arg == "--set" && i + 1 < argc && std::string(argv[i+1]).find('=') != std::string::npos) {
+            const std::string assignment = argv[++i];
+            const size_t equal = assignment.find('=');
+            conductances.push_back({assignment.substr(0, equal), parseValues(assignment.substr(equal + 1))});
+        } else if (arg == "--sigma" && i + 1 < argc) {
+            widths.clear();
+            for (double scale : parseValues(argv[++i])) {
+                widths.push_back(defaultWidths());
+                for (double& width : widths.back()) {
+                    width *= scale;
+                }
+            }
+        } else if (arg == "--steps" && i + 1 < argc) {
+            steps = std::stoi(argv[++i]);
+        } else if (arg == "--output" && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--seeds 1,2] [--drive none,poisson,ou]"
+                      << " [--noise 0,0.1] [--set PY.g_KNa=1,1.33] [--sigma 0.5,1]"
+                      << " [--steps 50000] [--output .]\n";
+            return 1;
+        }
+    }
+
+    std::vector<populationParameters> parameters;
+    try {
+        if (!driveNames.empty()) {
+            drives.clear();
+            for (const std::string& drive : driveNames) {
+                drives.push_back(getDrive(drive));
+            }
+        }
+        parameters = getParameters(conductances);
+    } catch (const std::exception& error) {
+        std::cerr << error.what() << "\n";
+        return 1;
+    }
+    Parameter_Sweep sweep(Parameter_Sweep::grid(seeds, drives, noises, parameters, widths));
+    std::cout << sweep.settings().size() << " points with " << sweep.threadsPerRun()
+              << " threads per run\n";
+    sweep.run(steps, output);
+    for (unsigned p=0; p < sweep.results().size(); ++p) {
+        const sweepSummary& summary = sweep.results()[p];
+        std::cout << "point " << p << ": " << summary.rate_PY << " Hz PY, " << summary.rate_IN
+                  << " Hz IN, took " << summary.seconds << " seconds\n";
+    }
+    std::cout << "end\n";
+}
+/****************************************************************************************************/
+/*										 		end			 										*/
+/****************************************************************************************************/
@@ -0,0 +1,846 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+/****************************************************************************************************/
+/*								Synaptic input of the network										*/
+/****************************************************************************************************/
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "Banded_Connectivity.h"
+#include "Connectivity.h"
+#include "Dense_Connectivity.h"
+#include "Domain_Decomposition.h"
+#include "External_Drive.h"
+#include "Langevin_Noise.h"
+#include "Network_Image.h"
+#include "Outgoing_Connectivity.h"
+#include "Population_Parameters.h"
+#include "Profiler.h"
+#include "Simd_Lanes.h"
+#include "Stimulus_Stream.h"
+#include "Thread_Placement.h"
+#include "Inhibitory_Neuron.h"
+#include "Pyramidal_Neuron.h"
+#include "Reticular_Neuron.h"
+#include "Thalamocortical_Neuron.h"
+
+/* NOTE The synaptic input of a RK step is computed in three phases. First the synaptic variables
+ * of every neuron are collected into contiguous arrays per population (publish). Then the inputs
+ * of every neuron are summed from those arrays (sum) and finally handed to the neurons (deliver).
+ * As the RK step N only reads the synaptic variables of step N, this is equivalent to summing the
+ * input within set_RK(N).
+ *
+ * The connectivity is either read from the CSR arrays of the network image or, in procedural
+ * mode, regenerated from the counter-based random streams on every step. The latter does not
+ * store any synapse, so memory does not grow with the number of synapses, but it is far slower:
+ * every synapse costs a normal draw per RK step, about 45 ns, against a few ns for reading it.
+ * With one core, 2000 steps of the default network took 7.6 s against 0.56 s in stored mode on
+ * the ring, and 57 s against 0.85 s on the sheet, where every synapse also searches the cell list.
+ * The connectivity is drawn per presynaptic neuron, so the targets are pushed into a buffer of
+ * 3 doubles per postsynaptic neuron and thread, which are added up in thread order. With one
+ * thread this is the order of the CSR rows and the result equals stored mode, with more threads
+ * it changes in the last bits with N_Cores.
+ *
+ * When the network is decomposed across ranks, the neurons are the owned ones of every population.
+ * The published arrays are provided by the domain and indexed by the global neuron index, the
+ * halo is exchanged between publish and sum.
+ *
+ * Stored projections are summed through the CSR rows, as a dense band of diagonals around the
+ * ring (Banded_Connectivity.h) or as a dense matrix (Dense_Connectivity.h). The automatic engine
+ * picks the cheapest one per projection. The band and the matrix add the inputs of a neuron in a
+ * different order than its CSR row, so the results change in the last bits with the engine.
+ *
+ * With delta propagation the inputs are running totals. Every RK step only the presynaptic
+ * neurons whose synaptic variables moved by more than a tolerance since they were last pushed
+ * are pushed through the outgoing synapses (Outgoing_Connectivity.h), so quiet populations cost
+ * a comparison per neuron. Changes below the tolerance are kept until they accumulate, and the
+ * totals are summed in full every few time steps to remove the rounding drift.
+ *
+ * The external drive (External_Drive.h) and the voltage noise (Langevin_Noise.h) are handed to the
+ * neurons together with the synaptic input of the first RK step of every time step. A stimulus
+ * (Stimulus_Stream.h) is evaluated at the time of every RK step.
+ *
+ * An ensemble simulates several trials of the network over the shared connectivity. The trials of
+ * a neuron are stored next to each other, in the SIMD lanes of the neuron objects (Simd_Lanes.h)
+ * and in the published and summed arrays, so set_RK and add_RK advance Lanes trials per vector
+ * instruction, every synapse adds the outputs of all trials in a single vector loop and the gather
+ * becomes a product of the sparse connectivity with a dense matrix of the trials. Every trial has
+ * its own drive and noise, while a stimulus applies the same current to all trials.
+ */
+enum gatherEngine {
+    GATHER_CSR = 0,		/* Gather the inputs through the CSR rows						*/
+    GATHER_BANDED,		/* Dense band product where the projection allows it			*/
+    GATHER_DENSE,		/* Dense matrix product where the projection allows it			*/
+    GATHER_AUTO			/* Cheapest of the above per projection							*/
+};
+
+enum propagationMode {
+    PROPAGATE_PULL = 0,	/* Sum all inputs of every neuron on every RK step				*/
+    PROPAGATE_DELTA		/* Push the changes of the presynaptic neurons					*/
+};
+
+class Synaptic_Input {
+public:
+    Synaptic_Input() : single(new Domain()), domain(single.get()) {}
+    explicit Synaptic_Input(Domain& partition) : domain(&partition) {}
+
+    Synaptic_Input(const Synaptic_Input&) = delete;
+    Synaptic_Input& operator=(const Synaptic_Input&) = delete;
+
+    /* Take over the network image. In procedural mode the image carries no connectivity, which is
+     * regenerated with the connection widths the image has been generated with
+     */
+    void setup(Network_Image&& network, bool proceduralMode, networkLayout layout,
+               const std::vector<double>& width, gatherEngine engine = GATHER_AUTO) {
+        extern const std::vector<int> NumCells;
+        image		= std::move(network);
+        procedural	= proceduralMode;
+        space		= procedural ? Spatial_Layout(layout, NumCells, image.seed()) : Spatial_Layout();
+        if (procedural && domain->distributed()) {
+            throw std::runtime_error("Procedural connectivity cannot be decomposed across ranks!");
+        }
+        domain->setupHalo(image);
+        stage		= 0;
+        trials		= 1;
+        propagation	= PROPAGATE_PULL;
+        outgoing.clear();
+
+        for (int type=0; type < image.numPopulations(); ++type) {
+            const int numCells = domain->last(type) - domain->first(type);
+            firstTouch(in_AMPA[type], numCells);
+            firstTouch(in_NMDA[type], numCells);
+            firstTouch(in_GABA[type], numCells);
+            in_AMPA[type].assign(numCells, 0.0);
+            in_NMDA[type].assign(numCells, 0.0);
+            in_GABA[type].assign(numCells, 0.0);
+            for (auto &outputs : trialOutputs[type]) {
+                outputs.clear();
+            }
+        }
+
+        /* The projections onto a population are ordered by the presynaptic population */
+        for (auto &inputs : projections) {
+            inputs.clear();
+        }
+        bands.clear();
+        denses.clear();
+        for (const auto &proj : Projections) {
+            projection input;
+            input.pre	 = proj.second;
+            input.index	 = procedural ? -1 : image.findProjection(proj.first, proj.second);
+            input.sigma	 = getSigma(space, proj.first, width[proj.second]);
+            input.engine = procedural ? GATHER_CSR
+                         : selectEngine(image, input.index, engine,
+                                        domain->first(proj.first), domain->last(proj.first));
+            input.matrix = -1;
+            input.transposed = -1;
+            if (input.engine == GATHER_BANDED) {
+                input.matrix = bands.size();
+                bands.emplace_back(image, input.index, domain->first(proj.first), domain->last(proj.first));
+            } else if (input.engine == GATHER_DENSE) {
+                input.matrix = denses.size();
+                denses.emplace_back(image, input.index, domain->first(proj.first), domain->last(proj.first));
+            }
+            projections[proj.first].push_back(input);
+        }
+        for (auto &inputs : projections) {
+            std::sort(inputs.begin(), inputs.end(),
+                      [](const projection& a, const projection& b) {return a.pre < b.pre;});
+        }
+    }
+
+    /* Switch to delta propagation. A presynaptic neuron is pushed once one of its synaptic
+     * variables moved by more than tolerance, and the inputs are summed in full every
+     * resyncInterval time steps
+     */
+    void propagateDeltas(double tolerance, int resyncInterval) {
+        if (procedural) {
+            throw std::runtime_error("Delta propagation requires stored connectivity!");
+        }
+        if (resyncInterval < 1) {
+            throw std::runtime_error("The resync interval must be at least one time step!");
+        }
+        if (trials > 1) {
+            throw std::runtime_error("Delta propagation cannot be combined with an ensemble!");
+        }
+        propagation		= PROPAGATE_DELTA;
+        deltaTolerance	= tolerance;
+        resyncSteps		= resyncInterval;
+        sinceResync		= 0;
+
+        outgoing.clear();
+        for (int post=0; post < image.numPopulations(); ++post) {
+            for (projection& proj : projections[post]) {
+                proj.transposed = outgoing.size();
+                outgoing.emplace_back(image, proj.index, domain->first(post), domain->last(post));
+            }
+        }
+
+        /* Only the presynaptic neurons with owned targets are tracked */
+        for (int pre=0; pre < image.numPopulations(); ++pre) {
+            sources[pre].clear();
+            for (int i=0; i < image.numCells(pre); ++i) {
+                for (int post=0; post < image.numPopulations(); ++post) {
+                    const projection* proj = find(post, pre);
+                    if (proj && outgoing[proj->transposed].connected(i)) {
+                        sources[pre].push_back(i);
+                        break;
+                    }
+                }
+            }
+            pushed_A[pre].assign(image.numCells(pre), 0.0);
+            pushed_B[pre].assign(image.numCells(pre), 0.0);
+        }
+    }
+
+    /* Conductances of the run. The neurons do not keep them, set_RK reads them from here, so
+     * every population shares a single copy
+     */
+    void setChannels(const populationParameters& parameters) {channels_ = parameters;}
+    const populationParameters& channels(void) const {return channels_;}
+
+    /* Simulate numTrials trials of the network as an ensemble. The neuron vectors then hold the
+     * trials of every owned neuron next to each other, Lanes trials per neuron object. The
+     * projections are gathered through the CSR rows, which share the connectivity between the
+     * trials. Drive, noise and stimulus have to be set afterwards
+     */
+    void setTrials(int numTrials) {
+        if (numTrials < 1) {
+            throw std::runtime_error("An ensemble needs at least one trial!");
+        }
+        if (numTrials % Lanes != 0) {
+            throw std::runtime_error("The number of trials must be a multiple of the SIMD lanes!");
+        }
+        if (numTrials > 1 && (procedural || domain->distributed() || propagation == PROPAGATE_DELTA)) {
+            throw std::runtime_error("An ensemble requires stored connectivity on a single rank!");
+        }
+        trials = numTrials;
+        for (int type=0; type < image.numPopulations(); ++type) {
+            const int numCells = (domain->last(type) - domain->first(type))*trials;
+            firstTouch(in_AMPA[type], numCells);
+            firstTouch(in_NMDA[type], numCells);
+            firstTouch(in_GABA[type], numCells);
+            in_AMPA[type].assign(numCells, 0.0);
+            in_NMDA[type].assign(numCells, 0.0);
+            in_GABA[type].assign(numCells, 0.0);
+            for (int receptor=AMPA; receptor <= GABA; ++receptor) {
+                trialOutputs[type][receptor].clear();
+                if (trials > 1 && isExcitatory((neuronType)type) == (receptor != GABA)) {
+                    firstTouch(trialOutputs[type][receptor], numCells);
+                    trialOutputs[type][receptor].assign(numCells, 0.0);
+                }
+            }
+        }
+        if (trials > 1) {
+            for (auto &inputs : projections) {
+                for (projection& proj : inputs) {
+                    proj.engine = GATHER_CSR;
+                    proj.matrix = -1;
+                }
+            }
+            bands.clear();
+            denses.clear();
+        }
+    }
+
+    /* Drive the populations externally */
+    void setDrive(const std::vector<driveSettings>& settings) {
+        drive.setup(settings, image, *domain, trials);
+    }
+
+    /* Add Langevin noise with the given amplitude to the voltage of the populations */
+    void setNoise(const std::vector<double>& amplitude) {
+        noise.setup(amplitude, image, *domain, trials);
+    }
+
+    /* Stimulate the neurons with the currents of a stimulus file, an empty name stops it */
+    void setStimulus(const std::string& file) {
+        if (file.empty()) {
+            stimulus.close();
+            return;
+        }
+        stimulus.open(file, image, *domain, trials);
+    }
+
+    /* Continue the drive and noise with their values of the given time step instead of the first */
+    void continueInputs(int64_t step) {
+        drive.seek(step);
+        noise.seek(step);
+    }
+
+    /* Start over from the first time step with freshly initialized neurons. Drive, noise and
+     * stimulus are restarted by setting them again
+     */
+    void restart(void) {
+        stage		= 0;
+        sinceResync	= 0;
+    }
+
+    /* Sum the synaptic input of every neuron for RK step N. All phases run within a single
+     * parallel region, the member functions only contain orphaned worksharing loops
+     */
+    void gather(int N,
+                std::vector<Pyramidal_Neuron>& PY,
+                std::vector<Inhibitory_Neuron>& IN,
+                std::vector<Thalamocortical_Neuron>& TC,
+                std::vector<Reticular_Neuron>& RE) {
+        extern const int N_Cores;
+        if ((int)scratch.size() < N_Cores) {
+            scratch.resize(N_Cores);
+            for (auto &local : changes) {
+                local.resize(N_Cores);
+            }
+        }
+
+        for (int type=0; type < image.numPopulations(); ++type) {
+            if (trials > 1) {
+                out_AMPA[type] = trialOutputs[type][AMPA].data();
+                out_NMDA[type] = trialOutputs[type][NMDA].data();
+                out_GABA[type] = trialOutputs[type][GABA].data();
+            } else if (isExcitatory((neuronType)type)) {
+                out_AMPA[type] = domain->outputs(type, AMPA, stage);
+                out_NMDA[type] = domain->outputs(type, NMDA, stage);
+            } else {
+                out_GABA[type] = domain->outputs(type, GABA, stage);
+            }
+        }
+        ++stage;
+
+        /* Delta propagation sums the inputs in full on the first RK step of every resync interval */
+        const bool resync = propagation == PROPAGATE_PULL || (N == 0 && sinceResync == 0);
+        const bool driven = N == 0 && (drive.active() || noise.active());
+        if (propagation == PROPAGATE_DELTA && N == 0) {
+            sinceResync = (sinceResync + 1) % resyncSteps;
+        }
+        const bool stimulated = stimulus.active();
+        if (stimulated) {
+            stimulus.prepare(N);
+        }
+
+        #pragma omp parallel num_threads(runThreads())
+        {
+            {
+                PROFILE_PHASE(PUBLISH);
+                publishExcitatory(N, PY, PYRAMIDAL);
+                publishInhibitory(N, IN, INHIBITORY);
+                publishExcitatory(N, TC, THALAMOCORTICAL);
+                publishInhibitory(N, RE, RETICULAR);
+            }
+            #pragma omp barrier
+
+            if (domain->distributed()) {
+                #pragma omp master
+                {
+                    PROFILE_PHASE(EXCHANGE);
+                    domain->exchange(stage - 1);
+                }
+                #pragma omp barrier
+            }
+
+            {
+                PROFILE_PHASE(SUM);
+                if (!resync) {
+                    for (int type=0; type < image.numPopulations(); ++type) {
+                        collectChanges((neuronType)type);
+                    }
+                    #pragma omp barrier
+                    for (int type=0; type < image.numPopulations(); ++type) {
+                        pushChanges((neuronType)type);
+                    }
+                } else {
+                    for (int type=0; type < image.numPopulations(); ++type) {
+                        if (procedural) {
+                            sumProcedural((neuronType)type);
+                        } else if (trials > 1) {
+                            sumTrials((neuronType)type);
+                        } else {
+                            sumStored((neuronType)type);
+                        }
+                        if (propagation == PROPAGATE_DELTA) {
+                            collectChanges((neuronType)type, true);
+                        }
+                    }
+                }
+            }
+            #pragma omp barrier
+
+            {
+                PROFILE_PHASE(DELIVER);
+                deliver(PY, PYRAMIDAL);
+                deliver(IN, INHIBITORY);
+                deliver(TC, THALAMOCORTICAL);
+                deliver(RE, RETICULAR);
+            }
+
+            if (driven) {
+                PROFILE_PHASE(DRIVE_INPUT);
+                drive.apply(PY, PYRAMIDAL);
+                drive.apply(IN, INHIBITORY);
+                drive.apply(TC, THALAMOCORTICAL);
+                drive.apply(RE, RETICULAR);
+                noise.apply(PY, PYRAMIDAL);
+                noise.apply(IN, INHIBITORY);
+                noise.apply(TC, THALAMOCORTICAL);
+                noise.apply(RE, RETICULAR);
+            }
+
+            if (stimulated) {
+                PROFILE_PHASE(DRIVE_INPUT);
+                stimulus.apply(PY, PYRAMIDAL);
+                stimulus.apply(IN, INHIBITORY);
+                stimulus.apply(TC, THALAMOCORTICAL);
+                stimulus.apply(RE, RETICULAR);
+            }
+        }
+        if (driven) {
+            drive.advance();
+            noise.advance();
+        }
+        if (stimulated && N == 3) {
+            stimulus.advance();
+        }
+    }
+
+    /* Engine that gathers the projection from population pre onto population post */
+    gatherEngine engine(int post, int pre) const {
+        const projection* proj = find(post, pre);
+        return proj ? proj->engine : GATHER_CSR;
+    }
+
+    /* Number of stored synapses, zero in procedural mode */
+    uint64_t numSynapses(void) const {
+        uint64_t count = 0;
+        for (int proj=0; proj < image.numProjections(); ++proj) {
+            count += image.numSynapses(proj);
+        }
+        return count;
+    }
+
+    /* Memory of the stored connectivity, that is the network image and the matrices of the engines */
+    uint64_t connectivityBytes(void) const {
+        uint64_t bytes = image.bytes();
+        for (const Band_Matrix& band : bands) {
+            bytes += band.bytes();
+        }
+        for (const Dense_Matrix& dense : denses) {
+            bytes += dense.bytes();
+        }
+        for (const Outgoing_Synapses& synapses : outgoing) {
+            bytes += synapses.bytes();
+        }
+        return bytes;
+    }
+
+    /* Memory of the input and propagation buffers of the owned neurons */
+    uint64_t bufferBytes(void) const {
+        uint64_t bytes = 0;
+        for (int type=0; type < 4; ++type) {
+            bytes += sizeof(double)*(in_AMPA[type].size() + in_NMDA[type].size() + in_GABA[type].size()
+                                     + pushed_A[type].size() + pushed_B[type].size());
+            for (const auto &outputs : trialOutputs[type]) {
+                bytes += sizeof(double)*outputs.size();
+            }
+        }
+        return bytes;
+    }
+
+    /* Access to the network image and its decomposition */
+    const Network_Image& network(void) const {return image;}
+    int numTrials(void) const {return trials;}
+    Domain& partition(void) {return *domain;}
+    const Domain& partition(void) const {return *domain;}
+
+private:
+    /* Projection onto a population */
+    struct projection {
+        neuronType	pre;
+        int			index;	/* Index of the projection in the image, -1 in procedural mode */
+        double		sigma;	/* Width of the connection profile */
+        gatherEngine engine;
+        int			matrix;	/* Index of the band or dense matrix, -1 if gathered through CSR */
+        int			transposed;	/* Index of the outgoing synapses, -1 without delta propagation */
+    };
+
+    const projection* find(int post, int pre) const {
+        for (const projection& proj : projections[post]) {
+            if (proj.pre == pre) {
+                return &proj;
+            }
+        }
+        return nullptr;
+    }
+
+    /* Relative cost of an entry of the band or the dense matrix compared to a synapse gathered
+     * through CSR. With one core a synapse took 0.8 to 1.2 ns, a band entry 0.85 to 0.9 ns and a
+     * matrix entry 1.6 to 2.2 ns for 128 to 2048 pyramidal neurons, as the dot products of the
+     * rows are reduced at their end. With about 20 targets per neuron the dense matrix only pays
+     * off below about 10 postsynaptic neurons
+     */
+    static constexpr double BandCost  = 1.0;
+    static constexpr double DenseCost = 2.0;
+
+    /* Largest dense matrix of a projection in bytes */
+    static const uint64_t MaxDenseBytes = 64ULL << 20;
+
+    /* Engine of the owned rows [first, last) of a stored projection. A requested engine is used
+     * where it is applicable, the automatic one estimates the cost of every applicable engine per
+     * RK step
+     */
+    static gatherEngine selectEngine(const Network_Image& image, int proj, gatherEngine requested,
+                                     int first, int last) {
+        const double numPost	= last - first;
+        const double numPre		= image.numCells(image.pre (proj));
+        const bool	 dense		= numPost*numPre <= MaxDenseBytes && Dense_Matrix::applicable(image, proj);
+        const bool	 banded		= Band_Matrix::applicable(image, proj);
+        switch (requested) {
+        case GATHER_CSR:
+            return GATHER_CSR;
+        case GATHER_BANDED:
+            return banded ? GATHER_BANDED : GATHER_CSR;
+        case GATHER_DENSE:
+            return dense ? GATHER_DENSE : GATHER_CSR;
+        default:
+            break;
+        }
+
+        double bestCost = image.numSynapses(proj) + numPost;
+        gatherEngine best = GATHER_CSR;
+        if (dense && DenseCost*numPost*numPre < bestCost) {
+            bestCost = DenseCost*numPost*numPre;
+            best = GATHER_DENSE;
+        }
+        if (banded && BandCost*(2*Band_Matrix::bandWidth(image, proj, first, last) + 1)*numPost < bestCost) {
+            best = GATHER_BANDED;
+        }
+        return best;
+    }
+
+    template<class NEURON>
+    void publishExcitatory(int N, const std::vector<NEURON>& neurons, neuronType type) {
+        double* AMPA = out_AMPA[type] + (size_t)domain->first(type)*trials;
+        double* NMDA = out_NMDA[type] + (size_t)domain->first(type)*trials;
+        #pragma omp for schedule(static) nowait
+        for (unsigned i=0; i < neurons.size(); ++i) {
+            neurons[i].s_AMPA[N].store(AMPA + (size_t)i*Lanes);
+            neurons[i].s_NMDA[N].store(NMDA + (size_t)i*Lanes);
+        }
+    }
+
+    template<class NEURON>
+    void publishInhibitory(int N, const std::vector<NEURON>& neurons, neuronType type) {
+        double* GABA = out_GABA[type] + (size_t)domain->first(type)*trials;
+        #pragma omp for schedule(static) nowait
+        for (unsigned i=0; i < neurons.size(); ++i) {
+            neurons[i].s_GABA[N].store(GABA + (size_t)i*Lanes);
+        }
+    }
+
+    /* Pull the input of every postsynaptic neuron through the stored CSR rows */
+    void sumStored(neuronType post) {
+        const std::vector<projection>& inputs = projections[post];
+        const int first = domain->first(post);
+        int begin, end;
+        staticBlock(domain->last(post) - first, begin, end);
+        double* AMPA = in_AMPA[post].data();
+        double* NMDA = in_NMDA[post].data();
+        double* GABA = in_GABA[post].data();
+        std::fill(AMPA + begin, AMPA + end, 0.0);
+        std::fill(NMDA + begin, NMDA + end, 0.0);
+        std::fill(GABA + begin, GABA + end, 0.0);
+
+        for (const projection& proj : inputs) {
+            if (proj.engine == GATHER_DENSE) {
+                const Dense_Matrix& dense = denses[proj.matrix];
+                if (isExcitatory(proj.pre)) {
+                    dense.accumulate(first + begin, first + end, out_AMPA[proj.pre], out_NMDA[proj.pre],
+                                     AMPA + begin, NMDA + begin);
+                } else {
+                    dense.accumulate(first + begin, first + end, out_GABA[proj.pre], nullptr,
+                                     GABA + begin, nullptr);
+                }
+            } else if (proj.engine == GATHER_BANDED) {
+                const Band_Matrix& band = bands[proj.matrix];
+                std::vector<double>& window = scratch[threadNum()];
+                if (isExcitatory(proj.pre)) {
+                    band.accumulate(first + begin, first + end, out_AMPA[proj.pre], out_NMDA[proj.pre],
+                                    AMPA + begin, NMDA + begin, window);
+                } else {
+                    band.accumulate(first + begin, first + end, out_GABA[proj.pre], nullptr,
+                                    GABA + begin, nullptr, window);
+                }
+            } else if (isExcitatory(proj.pre)) {
+                const double* s_AMPA = out_AMPA[proj.pre];
+                const double* s_NMDA = out_NMDA[proj.pre];
+                for (int j=begin; j < end; ++j) {
+                    double sum_AMPA = AMPA[j], sum_NMDA = NMDA[j];
+                    for (int i : image.inputs(proj.index, first + j)) {
+                        sum_AMPA += s_AMPA[i];
+                        sum_NMDA += s_NMDA[i];
+                    }
+                    AMPA[j] = sum_AMPA;
+                    NMDA[j] = sum_NMDA;
+                }
+            } else {
+                const double* s_GABA = out_GABA[proj.pre];
+                for (int j=begin; j < end; ++j) {
+                    double sum_GABA = GABA[j];
+                    for (int i : image.inputs(proj.index, first + j)) {
+                        sum_GABA += s_GABA[i];
+                    }
+                    GABA[j] = sum_GABA;
+                }
+            }
+        }
+    }
+
+    /* Pull the input of every trial of an ensemble through the stored CSR rows. The trials of a
+     * neuron are contiguous, so every synapse adds a row of the dense matrix of the trials
+     */
+    void sumTrials(neuronType post) {
+        const int K = trials;
+        int begin, end;
+        staticBlock(domain->last(post) - domain->first(post), begin, end);
+        double* AMPA = in_AMPA[post].data();
+        double* NMDA = in_NMDA[post].data();
+        double* GABA = in_GABA[post].data();
+        std::fill(AMPA + (size_t)begin*K, AMPA + (size_t)end*K, 0.0);
+        std::fill(NMDA + (size_t)begin*K, NMDA + (size_t)end*K, 0.0);
+        std::fill(GABA + (size_t)begin*K, GABA + (size_t)end*K, 0.0);
+
+        for (const projection& proj : projections[post]) {
+            if (isExcitatory(proj.pre)) {
+                for (int j=begin; j < end; ++j) {
+                    double* sum_AMPA = AMPA + (size_t)j*K;
+                    double* sum_NMDA = NMDA + (size_t)j*K;
+                    for (int i : image.inputs(proj.index, j)) {
+                        const double* s_AMPA = out_AMPA[proj.pre] + (size_t)i*K;
+                        const double* s_NMDA = out_NMDA[proj.pre] + (size_t)i*K;
+                        #pragma omp simd
+                        for (int k=0; k < K; ++k) {
+                            sum_AMPA[k] += s_AMPA[k];
+                            sum_NMDA[k] += s_NMDA[k];
+                        }
+                    }
+                }
+            } else {
+                for (int j=begin; j < end; ++j) {
+                    double* sum_GABA = GABA + (size_t)j*K;
+                    for (int i : image.inputs(proj.index, j)) {
+                        const double* s_GABA = out_GABA[proj.pre] + (size_t)i*K;
+                        #pragma omp simd
+                        for (int k=0; k < K; ++k) {
+                            sum_GABA[k] += s_GABA[k];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /* Collect the presynaptic neurons of a population whose synaptic variables moved by more than
+     * the tolerance since they were last pushed. The static schedule hands out ascending blocks,
+     * so the changes of all threads in thread order are sorted by neuron. After a full summation
+     * the current values are recorded as pushed instead
+     */
+    void collectChanges(neuronType pre, bool record = false) {
+        std::vector<synapticChange>& local = changes[pre][threadNum()];
+        local.clear();
+        const std::vector<int>& neurons = sources[pre];
+        const double* s_A = isExcitatory(pre) ? out_AMPA[pre] : out_GABA[pre];
+        const double* s_B = isExcitatory(pre) ? out_NMDA[pre] : nullptr;
+        double* last_A = pushed_A[pre].data();
+        double* last_B = pushed_B[pre].data();
+        #pragma omp for schedule(static) nowait
+        for (unsigned k=0; k < neurons.size(); ++k) {
+            const int i = neurons[k];
+            const double delta_A = s_A[i] - last_A[i];
+            const double delta_B = s_B ? s_B[i] - last_B[i] : 0.0;
+            if (record || std::fabs(delta_A) > deltaTolerance || std::fabs(delta_B) > deltaTolerance) {
+                if (!record) {
+                    local.push_back({i, delta_A, delta_B});
+                }
+                last_A[i] = s_A[i];
+                last_B[i] = s_B ? s_B[i] : 0.0;
+            }
+        }
+    }
+
+    /* Push the collected changes onto the owned block of postsynaptic neurons of every thread */
+    void pushChanges(neuronType post) {
+        int begin, end;
+        staticBlock(domain->last(post) - domain->first(post), begin, end);
+        const int numThreads = threadCount();
+        for (const projection& proj : projections[post]) {
+            const Outgoing_Synapses& synapses = outgoing[proj.transposed];
+            for (int t=0; t < numThreads; ++t) {
+                if (isExcitatory(proj.pre)) {
+                    synapses.push(changes[proj.pre][t], begin, end,
+                                  in_AMPA[post].data(), in_NMDA[post].data());
+                } else {
+                    synapses.push(changes[proj.pre][t], begin, end, in_GABA[post].data(), nullptr);
+                }
+            }
+        }
+    }
+
+    /* Push the output of every presynaptic neuron to its regenerated targets. Every thread
+     * accumulates into its own buffer, which are then reduced in thread order, so the sums depend
+     * on the number of threads. Pulling the inputs per postsynaptic neuron would need the sources
+     * of a target, which the divergent model only yields by regenerating every presynaptic neuron.
+     * The final loop keeps its barrier, as the buffers are reused for the next population
+     */
+    void sumProcedural(neuronType post) {
+        const int numCells = image.numCells(post);
+        const uint64_t seed = image.seed();
+        const std::vector<projection>& inputs = projections[post];
+        const int thread = threadNum();
+        std::vector<double>& local = scratch[thread];
+        local.assign(3*numCells, 0.0);
+        double* AMPA = local.data();
+        double* NMDA = AMPA + numCells;
+        double* GABA = NMDA + numCells;
+
+        for (const projection& proj : inputs) {
+            const neuronType pre = proj.pre;
+            const int numPre = image.numCells(pre);
+            if (isExcitatory(pre)) {
+                const double* s_AMPA = out_AMPA[pre];
+                const double* s_NMDA = out_NMDA[pre];
+                #pragma omp for schedule(static) nowait
+                for (int i=0; i < numPre; ++i) {
+                    getTargets(space, post, pre, i, proj.sigma, seed, [&](int Target) {
+                        AMPA[Target] += s_AMPA[i];
+                        NMDA[Target] += s_NMDA[i];
+                    });
+                }
+            } else {
+                const double* s_GABA = out_GABA[pre];
+                #pragma omp for schedule(static) nowait
+                for (int i=0; i < numPre; ++i) {
+                    getTargets(space, post, pre, i, proj.sigma, seed, [&](int Target) {
+                        GABA[Target] += s_GABA[i];
+                    });
+                }
+            }
+        }
+
+        #pragma omp barrier
+        const int numThreads = threadCount();
+        #pragma omp for schedule(static)
+        for (int j=0; j < numCells; ++j) {
+            double tot_AMPA = 0.0, tot_NMDA = 0.0, tot_GABA = 0.0;
+            for (int t=0; t < numThreads; ++t) {
+                tot_AMPA += scratch[t][j];
+                tot_NMDA += scratch[t][j +   numCells];
+                tot_GABA += scratch[t][j + 2*numCells];
+            }
+            in_AMPA[post][j] = tot_AMPA;
+            in_NMDA[post][j] = tot_NMDA;
+            in_GABA[post][j] = tot_GABA;
+        }
+    }
+
+    template<class NEURON>
+    void deliver(std::vector<NEURON>& neurons, neuronType type) {
+        #pragma omp for schedule(static) nowait
+        for (unsigned i=0; i < neurons.size(); ++i) {
+            neurons[i].tot_s_AMPA = lane::load(in_AMPA[type].data() + (size_t)i*Lanes);
+            neurons[i].tot_s_NMDA = lane::load(in_NMDA[type].data() + (size_t)i*Lanes);
+            neurons[i].tot_s_GABA = lane::load(in_GABA[type].data() + (size_t)i*Lanes);
+        }
+    }
+
+    static int threadNum(void) {
+#ifdef _OPENMP
+        return omp_get_thread_num();
+#else
+        return 0;
+#endif
+    }
+
+    static int threadCount(void) {
+#ifdef _OPENMP
+        return omp_get_num_threads();
+#else
+        return 1;
+#endif
+    }
+
+    /* Network image, which holds the CSR connectivity in stored mode */
+    Network_Image	image;
+    bool			procedural = false;
+
+    /* Positions of the neurons, only needed to regenerate the connectivity in procedural mode */
+    Spatial_Layout	space;
+
+    /* Projections onto every population and the band matrices of the banded engine */
+    std::vector<projection>		projections[4];
+    std::vector<Band_Matrix>	bands;
+    std::vector<Dense_Matrix>	denses;
+
+    /* Decomposition of the network, a single rank unless given on construction */
+    std::unique_ptr<Domain>	single;
+    Domain*					domain;
+    int						stage = 0;
+
+    /* Synaptic variables of the current RK step and summed input of the owned neurons */
+    double*				out_AMPA[4] = {}, *out_NMDA[4] = {}, *out_GABA[4] = {};
+    std::vector<double>	in_AMPA [4], in_NMDA [4], in_GABA [4];
+
+    /* Trials of an ensemble and their synaptic variables per population and receptor */
+    int					trials = 1;
+    std::vector<double>	trialOutputs[4][3];
+
+    /* Accumulation buffers of the threads in procedural mode */
+    std::vector<std::vector<double>> scratch;
+
+    /* Delta propagation */
+    propagationMode					propagation		= PROPAGATE_PULL;
+    double							deltaTolerance	= 0.0;
+    int								resyncSteps		= 1;
+    int								sinceResync		= 0;
+    std::vector<Outgoing_Synapses>	outgoing;
+    std::vector<int>				sources [4];	/* Presynaptic neurons with owned targets	*/
+    std::vector<double>				pushed_A[4];	/* Last pushed AMPA or GABA					*/
+    std::vector<double>				pushed_B[4];	/* Last pushed NMDA							*/
+    std::vector<std::vector<synapticChange>> changes[4];	/* Collected changes per thread		*/
+
+    /* Conductances of the run */
+    populationParameters			channels_;
+
+    /* External drive, voltage noise and stimulus of the neurons */
+    External_Drive					drive;
+    Langevin_Noise					noise;
+    Stimulus_Stream					stimulus;
+};
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
@@ -0,0 +1,137 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+/****************************************************************************************************/
+/*						Placement of the threads and their memory									*/
+/****************************************************************************************************/
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+/* NOTE Every loop over the neurons of a population uses schedule(static) with the runThreads()
+ * threads of the run, so that a neuron is always updated by the same thread. Memory is placed on
+ * the NUMA node of the thread that touches it first, so the population arrays are touched by the
+ * owning threads before the neurons are constructed into them. Pinning keeps the threads, and
+ * thereby their memory, on the same cores for the whole run.
+ */
+enum threadPinning {
+    PIN_NONE = 0,		/* Leave the placement to the operating system				*/
+    PIN_COMPACT,		/* Consecutive threads on consecutive cores					*/
+    PIN_SCATTER			/* Threads spread evenly over the available cores			*/
+};
+
+/* Threads of the parallel regions of a run, N_Cores unless the calling thread has been given a
+ * share of them. A parameter sweep runs several simulations side by side, each on its own share
+ */
+inline int& runThreadShare(void) {
+    static thread_local int share = 0;
+    return share;
+}
+
+inline int runThreads(void) {
+    extern const int N_Cores;
+    return runThreadShare() > 0 ? runThreadShare() : N_Cores;
+}
+
+/* Touch the storage of n elements, that has been reserved but not yet constructed, with the same
+ * static schedule that the loops over the neurons use
+ */
+template<class T>
+void firstTouch(std::vector<T>& storage, size_t n) {
+    storage.clear();
+    storage.shrink_to_fit();
+    storage.reserve(n);
+    char* bytes = reinterpret_cast<char*>(storage.data());
+    #pragma omp parallel for num_threads(runThreads()) schedule(static)
+    for (size_t i=0; i < n; ++i) {
+        std::memset(bytes + i*sizeof(T), 0, sizeof(T));
+    }
+}
+
+/* Contiguous block [begin, end) of n iterations handled by the calling thread, which is split like
+ * schedule(static). Used where a thread needs its whole block at once
+ */
+inline void staticBlock(int n, int& begin, int& end) {
+#ifdef _OPENMP
+    const int thread  = omp_get_thread_num();
+    const int threads = omp_get_num_threads();
+#else
+    const int thread  = 0;
+    const int threads = 1;
+#endif
+    const int chunk = n/threads;
+    const int extra = n%threads;
+    begin = thread*chunk + std::min(thread, extra);
+    end   = begin + chunk + (thread < extra ? 1 : 0);
+}
+
+/* Bind every thread of the team to a core. The ranks of a decomposed network on the same node
+ * take consecutive blocks of cores
+ */
+inline void pinThreads(threadPinning pinning, int rank = 0) {
+    extern const int N_Cores;
+    if (pinning == PIN_NONE) {
+        return;
+    }
+#if defined(__linux__) && defined(_OPENMP)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return;
+    }
+    std::vector<int> cores;
+    for (int cpu=0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            cores.push_back(cpu);
+        }
+    }
+    if (cores.empty()) {
+        return;
+    }
+
+    #pragma omp parallel num_threads(N_Cores)
+    {
+        const int thread = rank*N_Cores + omp_get_thread_num();
+        const int total  = cores.size();
+        const int stride = pinning == PIN_SCATTER ? std::max(1, total/N_Cores) : 1;
+        const int slot   = (thread*stride + thread*stride/total) % total;
+
+        cpu_set_t target;
+        CPU_ZERO(&target);
+        CPU_SET(cores[slot], &target);
+        sched_setaffinity(0, sizeof(target), &target);
+    }
+#else
+    (void)rank;
+#endif
+}
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/
@@ -0,0 +1,281 @@
+/*
+*	Copyright (c) 2016 Michael Schellenberger Costa mschellenbergercosta@gmail.com
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files (the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in
+*	all copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+
+/****************************************************************************************************/
+/*									Equilibrated initial state										*/
+/****************************************************************************************************/
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Channel_Set.h"
+#include "Domain_Decomposition.h"
+#include "External_Drive.h"
+#include "Iterate_ODE.h"
+#include "Network_Image.h"
+#include "Synaptic_Input.h"
+
+/* NOTE The neurons start with all gating variables at zero and the voltages at the leak reversal
+ * potential, so every run begins with a transient towards the attractor of the network. With a
+ * warm-up time the network is simulated for that long before the run and the neurons start from
+ * where the warm-up ended. The equilibrated neurons are stored in the cache directory of the
+ * network images, one file per rank
+ *
+ *		stateHeader
+ *		Pyramidal_Neuron		[numNeurons[PYRAMIDAL]]
+ *		Inhibitory_Neuron		[numNeurons[INHIBITORY]]
+ *		Thalamocortical_Neuron	[numNeurons[THALAMOCORTICAL]]
+ *		Reticular_Neuron		[numNeurons[RETICULAR]]
+ *
+ * The file name contains a hash of everything the warm-up depends on: the network image, the
+ * knocked out channels, the conductances, the drive and noise, the ensemble and the partition. The
+ * neurons are stored as they are in memory, so the hash also contains their sizes. The synaptic
+ * input, drive and noise restart after the warm-up, the latter two from the time step where the
+ * warm-up ended, so the run does not replay the realization of the warm-up. A run from the cache
+ * applies the same offset, so it is identical to a run that just computed the warm-up.
+ */
+struct stateHeader {
+    char		magic[8];
+    uint32_t	version;
+    uint32_t	rank;
+    uint64_t	stateHash;
+    uint64_t	numNeurons[4];
+};
+
+/* Revision of the stored state. Has to be increased whenever the dynamics of the neurons change,
+ * as it invalidates all cached states
+ */
+static const uint32_t StateRevision = 2;
+
+/* Hash of all settings that determine the state of the network after the warm-up */
+static uint64_t getStateHash(const Network_Image& image, const std::vector<driveSettings>& drive,
+                             const std::vector<double>& noise, const populationParameters& parameters,
+                             int ranks) {
+    extern const double dt;
+    extern const double WarmupTime;
+    extern const int Trials;
+    extern const gatherEngine Engine;
+    extern const propagationMode Propagation;
+    extern const double DeltaTolerance;
+    extern const int ResyncInterval;
+    const uint64_t configHash = image.configHash();
+    const uint64_t seed = image.seed();
+    const unsigned knockedOut = KnockedOut;
+    const uint64_t sizes[4] = {sizeof(Pyramidal_Neuron), sizeof(Inhibitory_Neuron),
+                               sizeof(Thalamocortical_Neuron), sizeof(Reticular_Neuron)};
+    uint64_t hash = hash_bytes(&StateRevision, sizeof(StateRevision));
+    hash = hash_bytes(&configHash, sizeof(configHash), hash);
+    hash = hash_bytes(&seed, sizeof(seed), hash);
+    hash = hash_bytes(&knockedOut, sizeof(knockedOut), hash);
+    hash = hash_bytes(sizes, sizeof(sizes), hash);
+    hash = hash_bytes(&dt, sizeof(dt), hash);
+    hash = hash_bytes(&WarmupTime, sizeof(WarmupTime), hash);
+    hash = hash_bytes(&Trials, sizeof(Trials), hash);
+    hash = hash_bytes(&ranks, sizeof(ranks), hash);
+    hash = hash_bytes(&Engine, sizeof(Engine), hash);
+    hash = hash_bytes(&Propagation, sizeof(Propagation), hash);
+    if (Propagation == PROPAGATE_DELTA) {
+        hash = hash_bytes(&DeltaTolerance, sizeof(DeltaTolerance), hash);
+        hash = hash_bytes(&ResyncInterval, sizeof(ResyncInterval), hash);
+    }
+    /* Field by field, as the padding of the settings is undefined */
+    for (const driveSettings& settings : drive) {
+        hash = hash_bytes(&settings.mode, sizeof(settings.mode), hash);
+        if (settings.mode != DRIVE_NONE) {
+            const double values[5] = {settings.rate, settings.weight, settings.mean, settings.sigma, settings.tau};
+            hash = hash_bytes(values, sizeof(values), hash);
+        }
+    }
+    forEachParameter(parameters, [&hash](const char*, const double& value) {
+        hash = hash_bytes(&value, sizeof(value), hash);
+    });
+    return hash_bytes(noise.data(), noise.size()*sizeof(double), hash);
+}
+
+class Warm_Start {
+public:
+    /* Bring freshly initialized neurons into the equilibrated state of the network, from the cache
+     * or by simulating the warm-up. Expects the drive and noise to be set, but no stimulus
+     */
+    static void equilibrate(std::vector<Pyramidal_Neuron>& PY,
+                            std::vector<Inhibitory_Neuron>& IN,
+                            std::vector<Thalamocortical_Neuron>& TC,
+                            std::vector<Reticular_Neuron>& RE,
+                            Synaptic_Input& synapses,
+                            const std::vector<driveSettings>& drive,
+                            const std::vector<double>& noise) {
+        extern const double dt;
+        extern const double WarmupTime;
+        extern const std::string NetworkCache;
+        const long steps = std::lround(WarmupTime/dt);
+        if (steps <= 0) {
+            return;
+        }
+        Domain& domain = synapses.partition();
+        const uint64_t stateHash = getStateHash(synapses.network(), drive, noise, synapses.channels(), domain.size());
+        const std::vector<uint64_t> counts = {PY.size(), IN.size(), TC.size(), RE.size()};
+
+        /* The warm-up exchanges the input between the ranks, so either all of them load their
+         * state or none does. Every rank therefore checks the files of all ranks
+         */
+        bool cached = !NetworkCache.empty();
+        for (int rank=0; cached && rank < domain.size(); ++rank) {
+            cached = valid(file(stateHash, rank), stateHash, rank);
+        }
+
+        if (cached) {
+            load(file(stateHash, domain.rank()), counts, PY, IN, TC, RE);
+        } else {
+            for (long t=0; t < steps; ++t) {
+                Iterate_ODE(PY, IN, TC, RE, synapses);
+            }
+            if (!NetworkCache.empty()) {
+                try {
+                    save(file(stateHash, domain.rank()), stateHash, domain.rank(), counts, PY, IN, TC, RE);
+                } catch (const std::exception&) {
+                    /* The cache is only an optimization, so an unwritable directory is not an error */
+                }
+            }
+        }
+
+        /* Start the run where the warm-up ended. Drive and noise restart from their stationary
+         * state, but continue their streams after the steps of the warm-up
+         */
+        synapses.restart();
+        synapses.setDrive(drive);
+        synapses.setNoise(noise);
+        synapses.continueInputs(steps);
+    }
+
+private:
+    static const char* magic(void) {return "BZSTATE1";}
+
+    static std::string file(uint64_t stateHash, int rank) {
+        extern const std::string NetworkCache;
+        char name[64];
+        snprintf(name, sizeof(name), "/state_%016llx_%d.bin", (unsigned long long)stateHash, rank);
+        return NetworkCache + name;
+    }
+
+    static uint64_t fileSize(const uint64_t numNeurons[4]) {
+        return sizeof(stateHeader) + numNeurons[PYRAMIDAL]*sizeof(Pyramidal_Neuron)
+                                   + numNeurons[INHIBITORY]*sizeof(Inhibitory_Neuron)
+                                   + numNeurons[THALAMOCORTICAL]*sizeof(Thalamocortical_Neuron)
+                                   + numNeurons[RETICULAR]*sizeof(Reticular_Neuron);
+    }
+
+    /* Check the header of the state of a rank and the size of the file */
+    static bool valid(const std::string& name, uint64_t stateHash, int rank) {
+        std::ifstream in(name, std::ios::binary | std::ios::ate);
+        if (!in) {
+            return false;
+        }
+        const uint64_t size = in.tellg();
+        stateHeader header;
+        in.seekg(0);
+        if (size < sizeof(header) || !in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+            return false;
+        }
+        return std::memcmp(header.magic, magic(), sizeof(header.magic)) == 0
+            && header.version	== StateRevision
+            && header.rank		== (uint32_t)rank
+            && header.stateHash	== stateHash
+            && size == fileSize(header.numNeurons);
+    }
+
+    /* The neurons hold only numbers, so they are stored as they are in memory */
+    template<class NEURON>
+    static void write(std::ofstream& out, const std::vector<NEURON>& neurons) {
+        static_assert(std::is_trivially_copyable<NEURON>::value, "The neurons are stored bytewise");
+        out.write(reinterpret_cast<const char*>(neurons.data()), neurons.size()*sizeof(NEURON));
+    }
+
+    template<class NEURON>
+    static void read(std::ifstream& in, std::vector<NEURON>& neurons) {
+        static_assert(std::is_trivially_copyable<NEURON>::value, "The neurons are stored bytewise");
+        in.read(reinterpret_cast<char*>(neurons.data()), neurons.size()*sizeof(NEURON));
+    }
+
+    /* Write the state of the rank. The file is renamed into place so that concurrent readers
+     * never observe a partially written state
+     */
+    static void save(const std::string& name, uint64_t stateHash, int rank, const std::vector<uint64_t>& counts,
+                     const std::vector<Pyramidal_Neuron>& PY,
+                     const std::vector<Inhibitory_Neuron>& IN,
+                     const std::vector<Thalamocortical_Neuron>& TC,
+                     const std::vector<Reticular_Neuron>& RE) {
+        stateHeader header = {};
+        std::memcpy(header.magic, magic(), sizeof(header.magic));
+        header.version	 = StateRevision;
+        header.rank		 = rank;
+        header.stateHash = stateHash;
+        std::copy(counts.begin(), counts.end(), header.numNeurons);
+
+        const std::string temporary = Network_Image::temporaryFile(name);
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        write(out, PY);
+        write(out, IN);
+        write(out, TC);
+        write(out, RE);
+        out.close();
+        if (!out || std::rename(temporary.c_str(), name.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            throw std::runtime_error("Could not write the initial state " + name);
+        }
+    }
+
+    /* Overwrite the freshly initialized neurons with the stored ones */
+    static void load(const std::string& name, const std::vector<uint64_t>& counts,
+                     std::vector<Pyramidal_Neuron>& PY,
+                     std::vector<Inhibitory_Neuron>& IN,
+                     std::vector<Thalamocortical_Neuron>& TC,
+                     std::vector<Reticular_Neuron>& RE) {
+        std::ifstream in(name, std::ios::binary);
+        stateHeader header;
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!in || !std::equal(counts.begin(), counts.end(), header.numNeurons)) {
+            throw std::runtime_error("The initial state " + name + " does not fit the network!");
+        }
+        read(in, PY);
+        read(in, IN);
+        read(in, TC);
+        read(in, RE);
+        if (!in) {
+            throw std::runtime_error("Could not read the initial state " + name);
+        }
+    }
+};
+/******************************************************************************/
+/*                                  end                                       */
+/******************************************************************************/